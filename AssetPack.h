@@ -0,0 +1,146 @@
+// asset pack file format for FEH Survivors, shared by the game and the packer
+
+
+#ifndef ASSETPACK_H
+
+#define ASSETPACK_H
+
+
+#include <cstddef>
+
+
+// an asset pack starts with an AssetPackHeader, then count AssetPackEntry sorted by name hash, then the sprite runs
+
+const char ASSET_PACK_MAGIC[4] = {'F', 'E', 'H', 'P'};
+
+const int ASSET_PACK_VERSION = 2;
+
+
+struct AssetPackHeader {
+
+    char magic[4];
+
+    int version;
+
+    int count;
+
+};
+
+
+/*
+
+*   one image in the pack. its runs (see encodeSpriteRuns) are words 4 byte words starting offset bytes
+
+*   from the start of the file, in the same layout the game draws from, so they are used in place
+
+*/
+
+struct AssetPackEntry {
+
+    unsigned int nameHash;
+
+    unsigned int offset;
+
+    int width, height;
+
+    int words;
+
+};
+
+
+// a see-through pixel (-1 in a .pic)
+
+const unsigned int SEE_THROUGH = 0xFFFFFFFFu;
+
+
+/*
+
+*   turns width * height colors into runs of pixels that aren't see-through, so the see-through parts cost
+
+*   nothing to store or draw. every row is one word with how many runs it has, then each run is a word with
+
+*   its start column (low 16 bits) and length (high 16 bits) followed by that many colors.
+
+*   returns the size in words, pass NULL for runs to just get the size
+
+*/
+
+inline int encodeSpriteRuns(const unsigned int pixels[], int width, int height, unsigned int runs[]) {
+
+    int words = 0;
+
+    for (int row = 0; row < height; row++) {
+
+        const unsigned int* line = &pixels[row * width];
+
+        int countWord = words++;
+
+        int count = 0;
+
+
+        int col = 0;
+
+        while (col < width) {
+
+            // skip the see-through part
+
+            while (col < width && line[col] == SEE_THROUGH) col++;
+
+            if (col == width) break;
+
+
+            int start = col;
+
+            while (col < width && line[col] != SEE_THROUGH) col++;
+
+            int length = col - start;
+
+
+            if (runs != NULL) {
+
+                runs[words] = start | length << 16;
+
+                for (int i = 0; i < length; i++) {
+
+                    runs[words + 1 + i] = line[start + i];
+
+                }
+
+            }
+
+            words += 1 + length;
+
+            count++;
+
+        }
+
+
+        if (runs != NULL) runs[countWord] = count;
+
+    }
+
+    return words;
+
+}
+
+
+// FNV-1a hash of the file name the game asks for (like "Enemy1FEH.pic")
+
+inline unsigned int hashAssetName(const char name[]) {
+
+    unsigned int hash = 2166136261u;
+
+    for (int i = 0; name[i] != '\0'; i++) {
+
+        hash ^= (unsigned char)name[i];
+
+        hash *= 16777619u;
+
+    }
+
+    return hash;
+
+}
+
+
+#endif
@@ -0,0 +1,228 @@
+// packs .pic images into one asset pack file that FEH Survivors can map straight into memory (stored as runs)
+
+// usage: AssetPacker assetsFEH.pak *.pic
+
+
+#include "AssetPack.h"
+
+
+#include <algorithm>
+
+#include <cstdio>
+
+#include <cstring>
+
+#include <vector>
+
+
+struct PackedImage {
+
+    const char* name;
+
+    AssetPackEntry entry;
+
+    std::vector<unsigned int> runs;
+
+};
+
+
+/*
+
+*   reads a .pic file the same way the game does: the height and width, then one color per pixel (-1 is see-through)
+
+*/
+
+bool readPic(const char fileName[], PackedImage& image) {
+
+    FILE* file = fopen(fileName, "r");
+
+    if (file == NULL) return false;
+
+
+    int height, width;
+
+    if (fscanf(file, "%d %d", &height, &width) != 2 || width <= 0 || height <= 0) {
+
+        fclose(file);
+
+        return false;
+
+    }
+
+
+    std::vector<unsigned int> pixels(width * height);
+
+    for (int i = 0; i < width * height; i++) {
+
+        int color = -1;
+
+        fscanf(file, "%d", &color);
+
+        pixels[i] = color;
+
+    }
+
+    fclose(file);
+
+
+    // store it the way the game draws it
+
+    image.entry.width = width;
+
+    image.entry.height = height;
+
+    image.entry.words = encodeSpriteRuns(pixels.data(), width, height, NULL);
+
+    image.runs.resize(image.entry.words);
+
+    encodeSpriteRuns(pixels.data(), width, height, image.runs.data());
+
+    return true;
+
+}
+
+
+// the game looks images up by file name only, so drop any folders in front of it
+
+const char* baseName(const char path[]) {
+
+    const char* name = path;
+
+    for (const char* c = path; *c != '\0'; c++) {
+
+        if (*c == '/' || *c == '\\') name = c + 1;
+
+    }
+
+    return name;
+
+}
+
+
+bool byHash(const PackedImage& a, const PackedImage& b) {
+
+    return a.entry.nameHash < b.entry.nameHash;
+
+}
+
+
+int main(int argc, char* argv[]) {
+
+    if (argc < 3) {
+
+        fprintf(stderr, "usage: %s assetsFEH.pak image.pic...\n", argv[0]);
+
+        return 1;
+
+    }
+
+
+    std::vector<PackedImage> images(argc - 2);
+
+    for (int i = 0; i < argc - 2; i++) {
+
+        images[i].name = baseName(argv[i + 2]);
+
+        images[i].entry.nameHash = hashAssetName(images[i].name);
+
+        if (!readPic(argv[i + 2], images[i])) {
+
+            fprintf(stderr, "couldn't read %s\n", argv[i + 2]);
+
+            return 1;
+
+        }
+
+    }
+
+
+    // the game binary searches the index, and only keeps the hash, so two names can't share one
+
+    std::sort(images.begin(), images.end(), byHash);
+
+    for (size_t i = 1; i < images.size(); i++) {
+
+        if (images[i].entry.nameHash == images[i - 1].entry.nameHash) {
+
+            fprintf(stderr, "%s and %s have the same name hash, rename one\n", images[i - 1].name, images[i].name);
+
+            return 1;
+
+        }
+
+    }
+
+
+    // runs go right after the index, everything is 4 bytes so they stay aligned
+
+    unsigned int offset = sizeof(AssetPackHeader) + images.size() * sizeof(AssetPackEntry);
+
+    unsigned int rawBytes = 0;
+
+    for (size_t i = 0; i < images.size(); i++) {
+
+        images[i].entry.offset = offset;
+
+        offset += images[i].runs.size() * sizeof(unsigned int);
+
+        rawBytes += images[i].entry.width * images[i].entry.height * sizeof(unsigned int);
+
+    }
+
+
+    FILE* file = fopen(argv[1], "wb");
+
+    if (file == NULL) {
+
+        fprintf(stderr, "couldn't open %s\n", argv[1]);
+
+        return 1;
+
+    }
+
+
+    AssetPackHeader header;
+
+    memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+
+    header.version = ASSET_PACK_VERSION;
+
+    header.count = images.size();
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (size_t i = 0; i < images.size(); i++) {
+
+        fwrite(&images[i].entry, sizeof(AssetPackEntry), 1, file);
+
+    }
+
+    for (size_t i = 0; i < images.size(); i++) {
+
+        fwrite(images[i].runs.data(), sizeof(unsigned int), images[i].runs.size(), file);
+
+        printf("%s %dx%d, %d bytes (%d raw)\n", images[i].name, images[i].entry.width, images[i].entry.height,
+
+            images[i].entry.words * 4, images[i].entry.width * images[i].entry.height * 4);
+
+    }
+
+
+    bool ok = ferror(file) == 0;
+
+    fclose(file);
+
+    if (!ok) {
+
+        fprintf(stderr, "couldn't write %s\n", argv[1]);
+
+        return 1;
+
+    }
+
+
+    printf("packed %d images into %s (%u bytes, %u bytes of raw pixels)\n", header.count, argv[1], offset, rawBytes);
+
+    return 0;
+
+}
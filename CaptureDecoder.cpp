@@ -0,0 +1,195 @@
+// turns a frame capture written by FEH Survivors back into a sequence of PPM images
+
+// usage: CaptureDecoder captureFEH.bin frames/frame     (writes frames/frame00000.ppm, frames/frame00001.ppm, ...)
+
+
+#include "CaptureFormat.h"
+
+
+#include <cstdio>
+
+#include <cstring>
+
+
+/*
+
+*   writes the frame as a binary PPM, colors in the game are 0xRRGGBB
+
+*/
+
+bool writePPM(const char fileName[], const unsigned int frame[], int width, int height) {
+
+    FILE* file = fopen(fileName, "wb");
+
+    if (file == NULL) return false;
+
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+    for (int i = 0; i < width * height; i++) {
+
+        unsigned char rgb[3] = {(unsigned char)(frame[i] >> 16), (unsigned char)(frame[i] >> 8), (unsigned char)frame[i]};
+
+        fwrite(rgb, 1, 3, file);
+
+    }
+
+
+    fclose(file);
+
+    return true;
+
+}
+
+
+int main(int argc, char* argv[]) {
+
+    if (argc < 3) {
+
+        fprintf(stderr, "usage: %s captureFEH.bin output/prefix\n", argv[0]);
+
+        return 1;
+
+    }
+
+
+    FILE* file = fopen(argv[1], "rb");
+
+    if (file == NULL) {
+
+        fprintf(stderr, "couldn't open %s\n", argv[1]);
+
+        return 1;
+
+    }
+
+
+    // header is the magic then version, width and height
+
+    char magic[4];
+
+    int header[3];
+
+    if (fread(magic, 4, 1, file) != 1 || fread(header, sizeof(int), 3, file) != 3 ||
+
+        memcmp(magic, CAPTURE_MAGIC, 4) != 0 || header[0] != CAPTURE_VERSION) {
+
+        fprintf(stderr, "%s is not a version %d capture file\n", argv[1], CAPTURE_VERSION);
+
+        fclose(file);
+
+        return 1;
+
+    }
+
+    int width = header[1];
+
+    int height = header[2];
+
+
+    // the frame being rebuilt starts black, same as the encoder's
+
+    unsigned int* frame = new unsigned int[width * height];
+
+    memset(frame, 0, width * height * sizeof(unsigned int));
+
+    unsigned char* runs = new unsigned char[width * height * CAPTURE_RUN_SIZE];
+
+
+    int frames = 0;
+
+    bool ended = false;
+
+    CaptureTrailer trailer;
+
+    CaptureFrameHeader frameHeader;
+
+    while (fread(&frameHeader, sizeof(CaptureFrameHeader), 1, file) == 1) {
+
+        // the trailer has the same layout as a frame header
+
+        if (frameHeader.frame == CAPTURE_END) {
+
+            memcpy(&trailer, &frameHeader, sizeof(CaptureTrailer));
+
+            ended = true;
+
+            break;
+
+        }
+
+
+        if (frameHeader.size > (unsigned int)(width * height * CAPTURE_RUN_SIZE) ||
+
+            fread(runs, 1, frameHeader.size, file) != frameHeader.size) {
+
+            fprintf(stderr, "frame %u is cut off, stopping\n", frameHeader.frame);
+
+            break;
+
+        }
+
+
+        // undo the runs, XOR each one onto the pixels it covers
+
+        int pixel = 0;
+
+        for (unsigned int i = 0; i + CAPTURE_RUN_SIZE <= frameHeader.size; i += CAPTURE_RUN_SIZE) {
+
+            unsigned short length;
+
+            unsigned int value;
+
+            memcpy(&length, &runs[i], 2);
+
+            memcpy(&value, &runs[i + 2], 4);
+
+
+            for (int j = 0; j < length && pixel < width * height; j++) {
+
+                frame[pixel++] ^= value;
+
+            }
+
+        }
+
+
+        char fileName[512];
+
+        snprintf(fileName, sizeof(fileName), "%s%05u.ppm", argv[2], frameHeader.frame);
+
+        if (!writePPM(fileName, frame, width, height)) {
+
+            fprintf(stderr, "couldn't write %s\n", fileName);
+
+            break;
+
+        }
+
+        frames++;
+
+    }
+
+
+    printf("%d frames\n", frames);
+
+    if (ended) {
+
+        printf("%u frames dropped by the game\n", trailer.dropped);
+
+    } else {
+
+        fprintf(stderr, "no trailer, the game didn't finish writing the capture\n");
+
+    }
+
+
+    delete[] frame;
+
+    delete[] runs;
+
+    fclose(file);
+
+    return 0;
+
+}
@@ -0,0 +1,57 @@
+// frame capture file format for FEH Survivors, shared by the game and the capture decoder
+
+
+#ifndef CAPTUREFORMAT_H
+
+#define CAPTUREFORMAT_H
+
+
+// a capture file starts with the magic, then the version, width and height as ints
+
+const char CAPTURE_MAGIC[4] = {'F', 'E', 'H', 'C'};
+
+const int CAPTURE_VERSION = 1;
+
+
+/*
+
+*   comes before each frame. the frame is size bytes of runs, each run is a 2 byte length followed by
+
+*   the 4 byte XOR of the pixels against the previous frame (0 means unchanged). runs never cross rows,
+
+*   and the first frame is XORed against an all black frame
+
+*/
+
+struct CaptureFrameHeader {
+
+    unsigned int frame;
+
+    unsigned int time; // ms since capture started
+
+    unsigned int size;
+
+};
+
+
+const int CAPTURE_RUN_SIZE = 6;
+
+
+// the last header in the file has this as its frame number and no runs after it.
+
+// instead of the time and size it holds how many frames were written and how many the game dropped
+
+const unsigned int CAPTURE_END = 0xFFFFFFFFu;
+
+struct CaptureTrailer {
+
+    unsigned int end;
+
+    unsigned int frames;
+
+    unsigned int dropped;
+
+};
+
+
+#endif
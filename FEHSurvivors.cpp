@@ -13,1336 +13,8428 @@
 #include "FEHRandom.h"
 
 
+#include "TelemetryFormat.h"
+
+#include "CaptureFormat.h"
+
+#include "AssetPack.h"
+
+
 #include <cmath>
 
+#include <cstddef>
 
-const int WINDOW_WIDTH = 320;
+#include <cstdio>
 
-const int WINDOW_HEIGHT = 240;
+#include <cstdlib>
 
+#include <cstring>
 
-// define the structs for the weapons, including all the values that will change as they level up
+#include <new>
 
-struct Marble {
 
-    int level = -1;
+// uncomment to record gameplay events to telemetryFEH.bin (needs threads, so it's off for the Proteus)
 
-    int damage[3] = {1, 2, 3};
+// #define TELEMETRY
 
-    int cooldown[3] = {3000, 2000, 1000};
 
-};
+// uncomment to record every frame of gameplay to captureFEH.bin (also needs threads)
 
-struct Airfoil {
+// #define CAPTURE
 
-    int level = -1;
 
-    int damage[3] = {1, 3, 5};
+// uncomment to load sprites on a background thread before they are needed, so menus and level ups never wait on files
 
-    int cooldown[3] = {2000, 1750, 1500};
+// (also needs threads)
 
-    float moveBonus[3] = {0.2, 0.4, 0.6};
+// #define ASYNC_LOADING
 
-};
 
-struct Beam {
+// uncomment to have a scripted bot play instead of the touch screen, for soak tests and benchmarks
 
-    int level = -1;
+// #define BOT
 
-    int damage[3] = {1, 2, 3};
 
-    int length[3] = {40, 50, 70};
+// uncomment to keep a rewind history while playing and add a button to the game over screen that goes back
 
-    int color[3] = {SILVER, BROWN, GRAY};
+// REWIND_SECONDS and plays on from there (for looking at what happened)
 
-};
+// #define REWIND
 
-struct Circuit {
 
-    int level = -1;
+// uncomment to stop the game with an error if anything uses the heap once the game loop has warmed up (PC only)
 
-    int damage[3] = {1, 3, 5};
+// #define HEAP_CHECK
 
-    int cooldown[3] = {10000, 9000, 8000};
 
-    int hits[3] = {2, 4, 6};
+// uncomment to show touch to screen latency in the bottom corner and add it to latencyFEH.txt after each game
 
-};
+// #define LATENCY_STATS
 
-struct Report {
 
-    int level = -1;
+// uncomment to run the self checks from main instead of playing (exit code 1 if any fail)
 
-    int healing[3] = {20, 45, 80};
+// #define SELF_TEST
 
-};
 
+// uncomment to time the renderer and find how many enemies and attacks a frame can hold, from main instead of playing
 
-// define the Items struct that will be used to hold all of the player's items
+// #define BENCHMARK
 
-struct Items {
 
-    Marble marble;
+// memory mapping the asset pack (PC only, the Proteus reads it in instead)
 
-    Airfoil airfoil;
+#if defined(__unix__) || defined(__APPLE__)
 
-    Beam beam;
+#include <fcntl.h>
 
-    Circuit circuit;
+#include <sys/mman.h>
 
-    Report report;
+#include <sys/stat.h>
 
-};
+#include <unistd.h>
 
+#endif
 
-/*
 
-*   general base class for a moving entity with health
+#if defined(TELEMETRY) || defined(CAPTURE) || defined(ASYNC_LOADING)
 
-*   enemies, attacks, and player all inherit from this class
+#include <atomic>
 
-*  
+#include <chrono>
 
-*   @author Ryan
+#include <thread>
 
-*/
+#endif
 
-class Entity {
 
-    protected:
+#ifdef ASYNC_LOADING
 
-        int health;
+#include <condition_variable>
 
-        float x, y, speed;
+#include <mutex>
 
-        float angleFacing;
+#endif
 
-        int width, height;
 
-        char spriteName[30];
+// vector copies for the sprite blitter on PCs (the Proteus has neither, it copies without them)
 
-        FEHImage sprite;
+#if defined(__AVX2__)
 
-    public:
+#include <immintrin.h>
 
-        int getHealth();
+#elif defined(__SSE2__)
 
-        void setHealth(int set);
+#include <emmintrin.h>
 
-        float getX();
+#endif
 
-        float getY();
 
-        int getWidth();
+const int WINDOW_WIDTH = 320;
 
-        int getHeight();
+const int WINDOW_HEIGHT = 240;
 
-        float getAngle();
 
-        void setSpeed(float set);
+// uncomment to keep the frame and sprites as 8 bit indexes into one shared 256 color palette instead of full colors,
 
-        void moveToPoint(float xTo, float yTo);
+// which is a quarter of the memory and memory traffic (colors are only looked up when the frame is sent to the LCD)
 
-        bool isColliding(Entity other);
+// #define INDEXED_COLOR
 
-        bool isCollidingWithPoint(float x, float y);
 
-        void drawSelf();
+// uncomment to run the physics in Q16.16 fixed point instead of float,
 
-        void updateSprite(char[]);
+// so positions come out bit for bit the same on every compiler and device (and faster without an FPU)
 
-        void hurt(int dmg);
+// #define FIXED_POINT_PHYSICS
 
-};
 
+/*
 
-// self explanatory gets and sets
+*   Q16.16 fixed point number, 16 bits of whole number and 16 bits of fraction stored in one int.
 
-int Entity::getHealth() {
+*   multiplying and dividing go through 64 bits so they don't overflow
 
-    return health;
+*/
 
-}
+struct Fixed {
 
-void Entity::setHealth(int set) {
+    int raw;
 
-    health = set;
 
-}
+    Fixed() : raw(0) {}
 
-float Entity::getX() {
+    Fixed(int value) : raw(value * 65536) {}
 
-    return x;
+    // only meant for constants, converting a float that was read in exactly always gives the same result
 
-}
+    Fixed(double value) : raw((int)(value * 65536.0 + (value < 0 ? -0.5 : 0.5))) {}
 
-float Entity::getY() {
 
-    return y;
+    static Fixed fromRaw(int raw) {
 
-}
+        Fixed f;
 
-int Entity::getWidth() {
+        f.raw = raw;
 
-    return width;
+        return f;
 
-}
+    }
 
-int Entity::getHeight() {
 
-    return height;
+    // rounds towards zero like casting a float does
 
-}
+    explicit operator int() const { return raw / 65536; }
 
-float Entity::getAngle() {
+    explicit operator float() const { return raw / 65536.0f; }
 
-    return angleFacing;
 
-}
+    Fixed operator-() const { return fromRaw(-raw); }
 
-void Entity::setSpeed(float set) {
+    Fixed& operator+=(Fixed other) { raw += other.raw; return *this; }
 
-    speed = set;
+    Fixed& operator-=(Fixed other) { raw -= other.raw; return *this; }
 
-}
+    Fixed& operator*=(Fixed other) { raw = (int)(((long long)raw * other.raw) >> 16); return *this; }
 
+    Fixed& operator/=(Fixed other) { raw = (int)(((long long)raw * 65536) / other.raw); return *this; }
 
-/*
+};
 
-*   moves the entity to a point at their speed variable
 
-*
+inline Fixed operator+(Fixed a, Fixed b) { return a += b; }
 
-*   @author: Ryan
+inline Fixed operator-(Fixed a, Fixed b) { return a -= b; }
 
-*/
+inline Fixed operator*(Fixed a, Fixed b) { return a *= b; }
+
+inline Fixed operator/(Fixed a, Fixed b) { return a /= b; }
 
-void Entity::moveToPoint(float xTo, float yTo) {
+inline bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
 
+inline bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
 
-    float xMove, yMove;
+inline bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
 
+inline bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
 
-    // calculate the x and y component sizes from the current position to the desired position
+inline bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
 
-    float xDiff = xTo - x;
+inline bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
 
-    float yDiff = yTo - y;
 
+// pi and friends in raw Q16.16
 
-    // update anglefacing
+const int FIXED_PI = 205887;
 
-    angleFacing = atan2(yDiff, xDiff);
+const int FIXED_HALF_PI = 102944;
 
+const int FIXED_QUARTER_PI = 51472;
 
-    // uses the distance formula to find the length of the line from the current to desired position
 
-    float length = sqrt(xDiff*xDiff + yDiff*yDiff);
+/*
 
+*   integer square root of a 64 bit number, one bit at a time
 
-    // don't move if close enough to the desired point (prevents position flickering)
+*/
 
-    if (length <= 4) {
+unsigned long long integerSqrt(unsigned long long value) {
 
-        xMove = 0;
+    unsigned long long result = 0;
 
-        yMove = 0;
+    unsigned long long bit = 1ull << 62;
 
-    } else {
 
-        // normalize the vector
+    while (bit > value) bit >>= 2;
 
-        xDiff /= length;
 
-        yDiff /= length;
+    while (bit != 0) {
 
-        // make vector length equal to speed
+        if (value >= result + bit) {
 
-        xMove = xDiff * speed;
+            value -= result + bit;
 
-        yMove = yDiff * speed;
+            result = (result >> 1) + bit;
 
-    }
+        } else {
+
+            result >>= 1;
+
+        }
 
+        bit >>= 2;
 
-    // move the entity
+    }
 
-    x += xMove;
 
-    y += yMove;
+    return result;
 
+}
 
-    // if the entity would be going over the border of the window, lock them to the edge so they don't go offscreen
 
-    if (x > WINDOW_WIDTH - width) x = WINDOW_WIDTH - width;
+// length of the vector (x, y), squares are Q32.32 so the root comes straight back out as Q16.16
 
-    if (x < 0) x = 0;
+Fixed realLength(Fixed x, Fixed y) {
 
-    if (y > WINDOW_HEIGHT - height) y = WINDOW_HEIGHT - height;
+    long long squares = (long long)x.raw * x.raw + (long long)y.raw * y.raw;
 
-    if (y < 0) y = 0;
+    return Fixed::fromRaw((int)integerSqrt(squares));
 
 }
 
 
 /*
 
-*   returns true if the entity is colliding with another entity
+*   atan2 using a polynomial for atan on the first octant (max error around 0.0015 radians)
 
-*
-
-*   @author Ryan
+*   and then flipping it into the right octant
 
 */
 
-bool Entity::isColliding(Entity other) {
+Fixed realAtan2(Fixed y, Fixed x) {
 
+    if (x.raw == 0 && y.raw == 0) return Fixed();
 
-    // calculation to check if within bounds of other entity
 
-    if (x < other.getX() + other.getWidth() &&
+    long long absX = x.raw < 0 ? -(long long)x.raw : x.raw;
 
-        x + width > other.getX() &&
+    long long absY = y.raw < 0 ? -(long long)y.raw : y.raw;
 
-        y < other.getY() + other.getHeight() &&
 
-        y + height > other.getY()) {
+    // z is the smaller over the bigger so its between 0 and 1
 
-       
+    bool swapped = absY > absX;
 
-        return true;
+    int z = swapped ? (int)((absX << 16) / absY) : (int)((absY << 16) / absX);
 
-    }
 
+    // atan(z) ~= pi/4*z - z*(z - 1)*(0.2447 + 0.0663*z)
 
-    return false;
+    long long inner = 16036 + ((4345ll * z) >> 16);
 
-}
+    long long angle = (((long long)FIXED_QUARTER_PI * z) >> 16) - ((((long long)z * (z - 65536)) >> 16) * inner >> 16);
 
 
-/*
+    if (swapped) angle = FIXED_HALF_PI - angle;
 
-*   returns true if the entity is colliding with a point in space
+    if (x.raw < 0) angle = FIXED_PI - angle;
 
-*
+    if (y.raw < 0) angle = -angle;
 
-*   @author Ryan
+
+    return Fixed::fromRaw((int)angle);
+
+}
+
+
+/*
+
+*   sin using a parabola with one correction step (max error around 0.001)
 
 */
 
-bool Entity::isCollidingWithPoint(float pointX, float pointY) {
+Fixed realSin(Fixed angle) {
 
+    // wrap into -pi to pi
 
-    if (x < pointX && x + width > pointX && y < pointY && y + height > pointY) {
+    int a = angle.raw % (2*FIXED_PI);
 
-        return true;
+    if (a > FIXED_PI) a -= 2*FIXED_PI;
 
-    }
+    if (a < -FIXED_PI) a += 2*FIXED_PI;
 
 
-    return false;
+    // y = 4/pi*a - 4/pi^2*a*|a|
 
-}
+    long long absA = a < 0 ? -a : a;
 
+    long long y = ((83443ll * a) >> 16) - ((((26561ll * a) >> 16) * absA) >> 16);
 
-// main function that entities call to draw themselves to the screen
 
-void Entity::drawSelf() {
+    // y = 0.225*(y*|y| - y) + y
 
-    sprite.Open(spriteName);
+    long long absY = y < 0 ? -y : y;
 
-    sprite.Draw((int)x, (int)y);
+    y += (14746ll * (((y * absY) >> 16) - y)) >> 16;
 
-    sprite.Close();
 
-}
+    return Fixed::fromRaw((int)y);
 
+}
 
-// used to change the used sprite of the entity (walking animation, for example)
 
-void Entity::updateSprite(char spr[]) {
+Fixed realCos(Fixed angle) {
 
-    strcpy(spriteName, spr);
+    return realSin(angle + Fixed::fromRaw(FIXED_HALF_PI));
 
 }
 
 
-void Entity::hurt(int dmg) {
+// the float versions just use the normal math functions
+
+float realLength(float x, float y) {
 
-    health -= dmg;
+    return sqrt(x*x + y*y);
 
 }
 
+float realAtan2(float y, float x) {
 
-/*
+    return atan2(y, x);
 
-*   Player class for the player, most logic is handled in game method
+}
 
-*
+float realSin(float angle) {
 
-*   @author Ryan, Meenakshi
+    return sin(angle);
 
-*/
+}
 
-class Player : public Entity {
+float realCos(float angle) {
 
-    private:
+    return cos(angle);
 
-        int xp = 0, level = 0;
+}
 
-    public:
 
-        Player(float _x, float y, int width, int height, int _health, float speed, char spriteName[]);
+// Real is the type used for anything the physics touches
 
-        int getXp();
+#ifdef FIXED_POINT_PHYSICS
 
-        int getLevel();
+typedef Fixed Real;
 
-        void setXp(int set);
+#else
 
-        void setLevel(int set);
+typedef float Real;
 
-};
+#endif
 
 
-Player::Player(float _x, float _y, int _width, int _height, int _health, float _speed, char _spriteName[]) {
+// bytes the frame arena can hand out each tick (BENCHMARK has room for rewind snapshots of far more enemies)
 
-    x = _x;
+#ifdef BENCHMARK
 
-    y = _y;
+const int FRAME_ARENA_SIZE = 1024 * 1024;
 
-    width = _width;
+#else
 
-    height = _height;
+const int FRAME_ARENA_SIZE = 64 * 1024;
 
-    health = _health;
+#endif
 
-    speed = _speed;
 
-    strcpy(spriteName, _spriteName);
+/*
 
-}
+*   bump allocator for things that only live for one tick. allocating is just moving used forward,
 
+*   and everything is freed at once by resetFrameArena at the start of the next tick, so the game loop
 
-// self explanatory gets and sets
+*   never has to touch the heap
 
-int Player::getXp() {
+*/
 
-    return xp;
+struct FrameArena {
 
-}
+    alignas(16) unsigned char memory[FRAME_ARENA_SIZE];
 
-int Player::getLevel() {
+    int used;
 
-    return level;
+    int peak; // most used in any one tick, for sizing FRAME_ARENA_SIZE
 
-}
+};
 
-void Player::setXp(int set) {
 
-    xp = set;
+FrameArena frameArena;
 
-}
 
-void Player::setLevel(int set) {
+// returns 16 byte aligned memory that is good until the next resetFrameArena, or NULL if the arena is full
 
-    level = set;
+void* frameAlloc(int bytes) {
 
-}
+    int start = (frameArena.used + 15) & ~15;
 
+    if (start + bytes > FRAME_ARENA_SIZE) return NULL;
 
-/*
 
-*   Basic enemy class, most logic handled in game method
+    frameArena.used = start + bytes;
 
-*
+    if (frameArena.used > frameArena.peak) frameArena.peak = frameArena.used;
 
-*   @author Ryan, Meenakshi
+    return frameArena.memory + start;
 
-*/
+}
 
-class Enemy : public Entity {
 
-    private:
+// same as frameAlloc but constructs a T in it
 
-        int damage;
+template <class T>
 
-        int damageCooldown = 30;
+T* frameNew() {
 
-        bool onCooldown = false;
+    void* memory = frameAlloc(sizeof(T));
 
-    public:
+    if (memory == NULL) return NULL;
 
-        Enemy();
+    return new (memory) T();
 
-        Enemy(float x, float y, int width, int height, int health, float speed, int damage, char spriteName[]);
+}
 
-        int getDamage();
 
-        void lowerDamageCooldown();
+// frees everything allocated this tick (nothing in the arena has a destructor worth running)
 
-        int getDamageCooldown();
+void resetFrameArena() {
 
-        void setDamageCooldown(int set);
+    frameArena.used = 0;
 
-        bool isOnCooldown();
+}
 
-        void setIsOnCooldown(bool set);
 
-};
+// ticks to let the game warm up (pools filling, first frames sent) before heap allocations count as a bug
 
+const unsigned long HEAP_CHECK_WARMUP = 120;
 
-// default constructor for when ititializing enemy array
 
-Enemy::Enemy() {}
+#ifdef HEAP_CHECK
 
 
-Enemy::Enemy(float _x, float _y, int _width, int _height, int _health, float _speed, int _damage, char _spriteName[]) {
+// while this is true any heap allocation stops the game. it's per thread, so only the game loop gets checked
 
-    x = _x;
+// and the asset loader can still load things in the background
 
-    y = _y;
+thread_local bool heapCheckArmed = false;
 
-    width = _width;
 
-    height = _height;
+void heapCheckFail(size_t bytes) {
 
-    health = _health;
+    // disarm first, printing might allocate too
 
-    speed = _speed;
+    heapCheckArmed = false;
 
-    damage = _damage;
+    fprintf(stderr, "HEAP_CHECK: %lu byte heap allocation during a steady-state frame\n", (unsigned long)bytes);
 
-    strcpy(spriteName, _spriteName);
+    abort();
 
 }
 
 
-int Enemy::getDamage() {
+void setHeapCheck(bool armed) {
 
-    return damage;
+    heapCheckArmed = armed;
 
 }
 
 
 /*
 
-*   damagecooldown methods are used so enemies get invincibility frames for a moment after getting hit
+*   every form of new and delete below goes through these two, so they all check the same way and a block is
 
-*
+*   always given back to the allocator it came from. kept out of line so the compiler never sees a pointer
 
-*   @author Ryan
+*   from new reach free (which -Wmismatched-new-delete warns about)
 
 */
 
-void Enemy::lowerDamageCooldown() {
-
-    damageCooldown--;
+__attribute__((noinline)) void* heapAllocate(size_t bytes, size_t alignment) {
 
-}
+    if (heapCheckArmed) heapCheckFail(bytes);
 
-int Enemy::getDamageCooldown() {
 
-    return damageCooldown;
+    void* memory = NULL;
 
-}
+    if (alignment <= alignof(std::max_align_t)) {
 
-void Enemy::setDamageCooldown(int set) {
+        memory = malloc(bytes);
 
-    damageCooldown = set;
+    } else if (posix_memalign(&memory, alignment, bytes) != 0) {
 
-}
+        memory = NULL;
 
-bool Enemy::isOnCooldown() {
+    }
 
-    return onCooldown;
+    return memory;
 
 }
 
-void Enemy::setIsOnCooldown(bool set) {
+__attribute__((noinline)) void heapRelease(void* memory) {
 
-    onCooldown = set;
+    free(memory);
 
+}
 
-    // draw a box so theres a hit 'animation'
 
-    if (set) {
+// the throwing forms of new
 
-        LCD.SetFontColor(WHITE);
+void* heapAllocateOrThrow(size_t bytes, size_t alignment) {
 
-        LCD.FillRectangle(x, y, width, height);
+    void* memory = heapAllocate(bytes, alignment);
 
-    }
+    if (memory == NULL) throw std::bad_alloc();
+
+    return memory;
 
 }
 
 
-/*
+void* operator new(size_t bytes) {
 
-*   Basic attack class
+    return heapAllocateOrThrow(bytes, 0);
 
-*
+}
 
-*   @author Ryan
+void* operator new[](size_t bytes) {
 
-*/
+    return heapAllocateOrThrow(bytes, 0);
 
-class Attack : public Entity {
+}
 
-    private:
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept {
 
-        float angle;
+    return heapAllocate(bytes, 0);
 
-        int damage;
+}
 
-    public:
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept {
 
-        Attack();
+    return heapAllocate(bytes, 0);
 
-        Attack(float x, float y, int width, int height, int health, float angle, float speed, int damage, char spriteName[]);
+}
 
-        void move();
+void operator delete(void* memory) noexcept {
 
-        int getDamage();
+    heapRelease(memory);
 
-};
+}
 
+void operator delete[](void* memory) noexcept {
 
-// default constructor for attack array
+    heapRelease(memory);
 
-Attack::Attack() {}
+}
 
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
 
-Attack::Attack(float _x, float _y, int _width, int _height, int _health, float _angle, float _speed, int _damage, char _spriteName[]) {
+    heapRelease(memory);
 
-    x = _x;
+}
 
-    y = _y;
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
 
-    width = _width;
+    heapRelease(memory);
 
-    height = _height;
+}
 
-    health = _health;
 
-    angle = _angle;
+// C++14 passes the size to delete when it knows it
 
-    speed = _speed;
+#ifdef __cpp_sized_deallocation
 
-    damage = _damage;
+void operator delete(void* memory, size_t) noexcept {
 
-    strcpy(spriteName, _spriteName);
+    heapRelease(memory);
 
 }
 
+void operator delete[](void* memory, size_t) noexcept {
 
-// moves the attack in a direction based on its angle and speed
+    heapRelease(memory);
 
-void Attack::move() {
-
-    float xMove, yMove;
+}
 
+#endif
 
-    xMove = cos(angle) * speed;
 
-    yMove = sin(angle) * speed;
+// C++17 has its own new and delete for types aligned past what malloc guarantees
 
+#ifdef __cpp_aligned_new
 
-    x += xMove;
+void* operator new(size_t bytes, std::align_val_t alignment) {
 
-    y += yMove;
+    return heapAllocateOrThrow(bytes, (size_t)alignment);
 
 }
 
+void* operator new[](size_t bytes, std::align_val_t alignment) {
 
-int Attack::getDamage() {
-
-    return damage;
+    return heapAllocateOrThrow(bytes, (size_t)alignment);
 
 }
 
+void* operator new(size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {
 
-// template type T used so the removeFromArray function can be used for both attacks and enemies
-
-template <class T>
+    return heapAllocate(bytes, (size_t)alignment);
 
-void removeFromArray(T[], int, int);
+}
 
-void promptItemMenu(Items& items);
+void* operator new[](size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {
 
-void menu();
+    return heapAllocate(bytes, (size_t)alignment);
 
-int game();
+}
 
-void stats(int, int);
+void operator delete(void* memory, std::align_val_t) noexcept {
 
-void info();
+    heapRelease(memory);
 
-void credits();
+}
 
-bool promptDifficulty();
+void operator delete[](void* memory, std::align_val_t) noexcept {
 
-Enemy createEnemy(int lvl, bool hard, bool boss);
+    heapRelease(memory);
 
+}
 
-/*
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
 
-*   main game function. returns the score achieved during the session
+    heapRelease(memory);
 
-*
+}
 
-*   @author Ryan, Meenakshi, Agi
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
 
-*/
+    heapRelease(memory);
 
-int game() {
+}
 
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
 
-    // open the background to be drawn on each frame
+    heapRelease(memory);
 
-    FEHImage background;
+}
 
-    background.Open("BGFEH.pic");
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
 
+    heapRelease(memory);
 
-    // initialize score to 0 and starting xp to next level
+}
 
-    int score = 0;
+#endif
 
-    int xpToNextLevel = 5;
 
+#ifdef __GLIBC__
 
-    // prompt the difficulty menu
+// glibc lets a program replace malloc, so C allocations (fopen, image decoding in the FEH libraries) get caught too
 
-    LCD.Clear();
+extern "C" void* __libc_malloc(size_t bytes);
 
-    bool hardMode = promptDifficulty();
+extern "C" void* __libc_calloc(size_t count, size_t bytes);
 
+extern "C" void* __libc_realloc(void* memory, size_t bytes);
 
-    // create the main player object
 
-    Player player(150, 110, 16, 32, 20000, 1, "playerFEH.pic");
+extern "C" void* malloc(size_t bytes) {
 
-    // lower player health if in hard mode
+    if (heapCheckArmed) heapCheckFail(bytes);
 
-    if (hardMode) {
+    return __libc_malloc(bytes);
 
-        player.setHealth(15000);
+}
 
-    }
+extern "C" void* calloc(size_t count, size_t bytes) {
 
-   
+    if (heapCheckArmed) heapCheckFail(count * bytes);
 
-    // create the items struct and timers for each cooldown based item
+    return __libc_calloc(count, bytes);
 
-    Items items;
+}
 
-    unsigned long marbleTimer = 0;
+extern "C" void* realloc(void* memory, size_t bytes) {
 
-    unsigned long airfoilTimer = 0;
+    if (heapCheckArmed) heapCheckFail(bytes);
 
-    unsigned long circuitTimer = 0;
+    return __libc_realloc(memory, bytes);
 
+}
 
-    // create the array of enemies and a counter variable
+#endif
 
-    Enemy enemy[50]; // 50 is max
 
-    int enemyCounter = 0;
+#else
 
 
-    // initialize the spawn cooldown timers for each enemy spawning pattern
+// heap checking turned off, compiles away to nothing
 
-    int enemySpawnCooldown = 4000;
+inline void setHeapCheck(bool) {}
 
-    unsigned long enemySpawnTimer = 0;
 
+#endif
 
-    int enemyBurstSpawnCooldown = 26000;
 
-    unsigned long enemyBurstSpawnTimer = TimeNowMSec();
+// a color that no .pic pixel can be (they are 0xRRGGBB), used for see-through pixels and for "redraw this pixel"
 
+const unsigned int NO_COLOR = 0xFFFFFFFFu;
 
-    int enemyBossSpawnCooldown = 63000;
 
-    unsigned long enemyBossSpawnTimer = TimeNowMSec();
+#ifdef INDEXED_COLOR
 
 
-    // create the array of attacks and a counter variable
+// one pixel of the frame, an index into the palette
 
-    Attack attack[50]; // 50 is max
+typedef unsigned char Pixel;
 
-    int attackCounter = 0;
+// index 255 is never a color, it means the same as NO_COLOR
 
+const Pixel NO_PIXEL = 0xFF;
 
-    // keeps track of touch locations
+const int PALETTE_SIZE = 255;
 
-    float xTouch, yTouch;
 
+// slots in the color to index lookup, a power of two and a few times the palette so lookups stay short
 
-    // prompt the user for first item
+const int PALETTE_LOOKUP_SIZE = 1024;
 
-    LCD.Clear();
 
-    promptItemMenu(items);
+/*
 
+*   the shared palette. colors get added the first time they're used (the FEH color constants and sprite colors
 
-    // used for drawing player sprite flipped if facing left
+*   as sprites load), and once all 255 are taken any new color gets the closest one already there.
 
-    bool playerFacingRight = true;
+*   lookup remembers the index for every color asked for so far
 
+*/
 
-    bool endGame = false;
+struct Palette {
 
-    while (!endGame) {
+    unsigned int colors[PALETTE_SIZE + 1];
 
+    int count;
 
-        // if player is touching the screen
 
-        if (LCD.Touch(&xTouch, &yTouch)) {
+    unsigned int lookupColor[PALETTE_LOOKUP_SIZE];
 
+    unsigned char lookupIndex[PALETTE_LOOKUP_SIZE];
 
-            // move the player to the touched point
+    bool lookupUsed[PALETTE_LOOKUP_SIZE];
 
-            player.moveToPoint((xTouch - player.getWidth()/2), (yTouch - player.getHeight()/2));
+    int lookupCount;
 
+};
 
-            // update the direction the player is facing
 
-            playerFacingRight = (player.getAngle() > -M_PI_2 && player.getAngle() < M_PI_2);
+// black is always index 0, since that's what the frame starts out as
 
+Palette palette = {{0x000000}, 1, {}, {}, {}, 0};
 
-            if (playerFacingRight) {
 
-                // based on current time, alternate between walk and default sprite
+// the palette color closest to color (by the squared distance between the red, green and blue parts)
 
-                if (TimeNowMSec() % 500 < 250) {
+int closestPaletteColor(unsigned int color) {
 
-                    player.updateSprite("PlayerWalkFEH.pic");
+    int best = 0;
 
-                } else {
+    int bestDistance = 0x7FFFFFFF;
 
-                    player.updateSprite("PlayerFEH.pic");
+    for (int i = 0; i < palette.count; i++) {
 
-                }
+        int red = (int)(color >> 16 & 0xFF) - (int)(palette.colors[i] >> 16 & 0xFF);
 
-            } else { // player is facing left
+        int green = (int)(color >> 8 & 0xFF) - (int)(palette.colors[i] >> 8 & 0xFF);
 
-                // based on current time alternate between walk and default sprite, both flipped because facing left
+        int blue = (int)(color & 0xFF) - (int)(palette.colors[i] & 0xFF);
 
-                if (TimeNowMSec() % 500 < 250) {
+        int distance = red*red + green*green + blue*blue;
 
-                    player.updateSprite("PlayerWalkFlippedFEH.pic");
+        if (distance < bestDistance) {
 
-                } else {
+            best = i;
 
-                    player.updateSprite("PlayerFlippedFEH.pic");
+            bestDistance = distance;
 
-                }
+        }
 
-            }
+    }
 
-        } else { // force update sprite to the not walking one if not walking
+    return best;
 
-            if (playerFacingRight) {
+}
 
-                player.updateSprite("PlayerFEH.pic");
 
-            } else {
+// turns a color into the frame's pixel for it
 
-                player.updateSprite("PlayerFlippedFEH.pic");
+Pixel toPixel(unsigned int color) {
 
-            }
+    if (color == NO_COLOR) return NO_PIXEL;
 
-        }
 
+    // open addressing, starting from a multiplicative hash of the color
 
-        // if time to spawn enemy
+    int slot = (color * 2654435761u) >> 22;
 
-        if (TimeNowMSec() - enemySpawnTimer > enemySpawnCooldown) {
+    while (palette.lookupUsed[slot]) {
 
-            // reset spawn timer
+        if (palette.lookupColor[slot] == color) return palette.lookupIndex[slot];
 
-            enemySpawnTimer = TimeNowMSec();
+        slot = (slot + 1) & (PALETTE_LOOKUP_SIZE - 1);
 
+    }
 
-            // create enemy and add to the array
 
-            Enemy e = createEnemy(player.getLevel(), hardMode, false);
+    // new to the lookup, but it might already be in the palette (like black)
 
-            enemy[enemyCounter] = e;
+    int index = closestPaletteColor(color);
 
-            if (enemyCounter < 50) enemyCounter++;
+    if (palette.colors[index] != color && palette.count < PALETTE_SIZE) {
 
-        }
+        index = palette.count++;
 
+        palette.colors[index] = color;
 
-        // if time to spawn burst of enemies (3 at once, weaker) (can't happen while level 0)
+    }
 
-        if (TimeNowMSec() - enemyBurstSpawnTimer > enemyBurstSpawnCooldown && player.getLevel() > 0) {
 
-            // reset spawn timer
+    // stop remembering once the lookup is 3/4 full, so there is always an empty slot to end on
 
-            enemyBurstSpawnTimer = TimeNowMSec();
+    if (palette.lookupCount < PALETTE_LOOKUP_SIZE * 3 / 4) {
 
+        palette.lookupUsed[slot] = true;
 
-            // create three enemies of lower level and add to the array
+        palette.lookupColor[slot] = color;
 
-            for (int i = 0; i < 3; i++) {
+        palette.lookupIndex[slot] = index;
 
-                Enemy e = createEnemy(player.getLevel() / 2, hardMode, false);
+        palette.lookupCount++;
 
-                enemy[enemyCounter] = e;
+    }
 
-                if (enemyCounter < 50) enemyCounter++;
+    return index;
 
-            }
+}
 
-        }
 
+// the color a pixel stands for, only needed when the frame goes out
 
-        // if time to spawn BOSS(-like) enemy
+inline unsigned int pixelColor(Pixel pixel) {
 
-        if (TimeNowMSec() - enemyBossSpawnTimer > enemyBossSpawnCooldown) {
+    return palette.colors[pixel];
 
-            // reset spawn timer
+}
 
-            enemyBossSpawnTimer = TimeNowMSec();
 
+#else
 
-            // create boss enemy and add to the array
 
-            Enemy e = createEnemy(player.getLevel(), hardMode, true);
+// one pixel of the frame, the color itself
 
-            enemy[enemyCounter] = e;
+typedef unsigned int Pixel;
 
-            if (enemyCounter < 50) enemyCounter++;
+const Pixel NO_PIXEL = NO_COLOR;
 
-        }
 
+inline Pixel toPixel(unsigned int color) {
 
+    return color;
 
-        // handle attacks when player has the marble weapon
+}
 
-        if (items.marble.level > -1) {
+inline unsigned int pixelColor(Pixel pixel) {
 
+    return pixel;
 
-            // if time to spawn marble attack
+}
 
-            if (TimeNowMSec() - marbleTimer > items.marble.cooldown[items.marble.level]) {
 
-                // resets marble cooldown
+#endif
 
-                marbleTimer = TimeNowMSec();
 
+// FEH font size, used to know how much of the screen text covers
 
-                // makes 8 of them in 45 degree increments and adds them to the attack array
+const int CHAR_WIDTH = 12;
 
-                for (int i = 1; i < 9; i++) {
+const int CHAR_HEIGHT = 17;
 
-                    Attack a(player.getX() + player.getWidth()/2, player.getY() + player.getHeight()/2, 4, 4, 1, i*(M_PI_4), 2, items.marble.damage[items.marble.level], "MarbleFEH.pic");
 
-                    attack[attackCounter] = a;
+/*
 
-                    if (attackCounter < 50) attackCounter++;
+*   a sprite loaded into memory once. .pic files are the rows and columns followed by one color per pixel,
 
-                }
+*   with -1 for see-through pixels. sprites are kept as runs of the pixels that aren't see-through
 
-            }
+*   (see encodeSpriteRuns), and sprites from the asset pack point straight into the pack
 
-        }
+*/
 
+struct Sprite {
 
-        // handle attacks when player has the airfoil weapon
+    char name[30];
 
-        if (items.airfoil.level > -1) {
+    bool mirrored; // flipped left to right, made from the normal one when it's loaded
 
+    int width, height;
 
-            // updates player movespeed bonus from the item
+    const unsigned int* runs;
 
-            player.setSpeed(1 + items.airfoil.moveBonus[items.airfoil.level]);
+    int words;
 
+#ifdef INDEXED_COLOR
 
-            // if time to spawn airfoil attack
+    // the same runs with palette indexes instead of colors (see indexSpriteRuns), what drawSprite uses
 
-            if (TimeNowMSec() - airfoilTimer > items.airfoil.cooldown[items.airfoil.level]) {
+    const unsigned char* indexed;
 
-                // resets airfoil cooldown
+#endif
 
-                airfoilTimer = TimeNowMSec();
+};
 
 
-                // creates attack with player angle + pi so it shoots backwards and adds it to the attack array
+/*
 
-                Attack a(player.getX() + player.getWidth()/2, player.getY() + player.getHeight()/2, 6, 6, 8, player.getAngle() + M_PI, 2.5, items.airfoil.damage[items.airfoil.level], "AirfoilFEH.pic");
+*   the asset pack, if there is one. on PC it is mapped straight into memory so sprites point into the file
 
-                attack[attackCounter] = a;
+*   and nothing gets copied or parsed; the Proteus has no mmap, so there it is read in with one fread instead
 
-                if (attackCounter < 50) attackCounter++;
+*/
 
-            }
+struct AssetPack {
 
-        }
+    const unsigned char* data;
 
+    long size;
 
-        // handle attacks when player has the circuit weapon
+    const AssetPackEntry* entries;
 
-        if (items.circuit.level > -1) {
+    int count;
 
+};
 
-            // if time to spawn the circuit attack
 
-            if (TimeNowMSec() - circuitTimer > items.circuit.cooldown[items.circuit.level]) {
+AssetPack assetPack;
 
-                // resets circuit cooldown
 
-                circuitTimer = TimeNowMSec();
+// gives back a pack file's memory, however openAssetPack got it
 
+void releaseAssetPackData(const unsigned char* data, long size) {
 
-                // creates circuit attack with 0 speed and adds it to the attack array
+#if defined(__unix__) || defined(__APPLE__)
 
-                Attack a(player.getX() + player.getWidth()/2, player.getY() + player.getHeight()/2, 6, 4, items.circuit.hits[items.circuit.level], 0, 0, items.circuit.damage[items.circuit.level], "CircuitFEH.pic");
+    munmap((void*)data, size);
 
-                attack[attackCounter] = a;
+#else
 
-                if (attackCounter < 50) attackCounter++;
+    (void)size;
 
-            }
+    delete[] data;
 
-        }
+#endif
 
+}
 
-        // clears the LCD *after* most a good amount of computation work to prevent flickering
 
-        LCD.Clear();
+// true if the header, the index and every image's runs all fit in the file, so nothing read from the pack later
 
+// can go past its end
 
-        // draw background
+bool checkAssetPack(const unsigned char* data, long size) {
 
-        background.Draw(0, 0);
+    const AssetPackHeader* header = (const AssetPackHeader*)data;
 
+    if (memcmp(header->magic, ASSET_PACK_MAGIC, 4) != 0 || header->version != ASSET_PACK_VERSION || header->count < 0) {
 
-        // handle attacks when player has the beam weapon (because drawing it isnt handled from the attack array, it goes after the lcd is cleared)
+        return false;
 
-        if (items.beam.level > -1) {
+    }
 
-            // temp variables for the center of the player
 
-            float centerX = player.getX() + player.getWidth()/2;
+    long long indexEnd = sizeof(AssetPackHeader) + (long long)header->count * sizeof(AssetPackEntry);
 
-            float centerY = player.getY() + player.getHeight()/2;
+    if (indexEnd > size) return false;
 
 
-            // sets color of the beam based on item level
+    const AssetPackEntry* entries = (const AssetPackEntry*)(data + sizeof(AssetPackHeader));
 
-            LCD.SetFontColor(items.beam.color[items.beam.level]);
+    for (int i = 0; i < header->count; i++) {
 
+        const AssetPackEntry& entry = entries[i];
 
-            // temp variables for the end of the beam, calculated based on level
+        if (entry.width <= 0 || entry.height <= 0 || entry.words < entry.height) return false;
 
-            float beamX = items.beam.length[items.beam.level]*cos(player.getAngle());
+        if (entry.offset % 4 != 0 || entry.offset < indexEnd) return false;
 
-            float beamY = items.beam.length[items.beam.level]*sin(player.getAngle());
+        if ((long long)entry.offset + (long long)entry.words * 4 > size) return false;
 
+    }
 
-            // draw the beam
+    return true;
 
-            // conditional rendering if the angle is near vertical to prevent weird artifacting with vertical lines
+}
 
-            if (sin(player.getAngle()) > 0.99) {
 
-                LCD.DrawLine(centerX, centerY, centerX, centerY + items.beam.length[items.beam.level]);
+// opens the asset pack, returns false (and the game reads the .pic files instead) if it's missing, a different version
 
-            } else if (sin(player.getAngle()) < -0.99) {
+// or broken
 
-                LCD.DrawLine(centerX, centerY, centerX, centerY - items.beam.length[items.beam.level]);
+bool openAssetPack(const char fileName[]) {
 
-            } else {
+    const unsigned char* data = NULL;
 
-                LCD.DrawLine(centerX, centerY, centerX + beamX, centerY + beamY);
+    long size = 0;
 
-            }
 
-        }
+#if defined(__unix__) || defined(__APPLE__)
 
+    int file = open(fileName, O_RDONLY);
 
-        // handle logic for each enemy on screen
+    if (file < 0) return false;
 
-        for (int i = 0; i < enemyCounter; i++) {
 
-           
+    struct stat info;
 
-            // move enemy to player and draw self
+    if (fstat(file, &info) == 0 && info.st_size >= (long)sizeof(AssetPackHeader)) {
 
-            enemy[i].moveToPoint(player.getX(), player.getY());
+        size = info.st_size;
 
-            enemy[i].drawSelf();
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
 
+        if (map != MAP_FAILED) data = (const unsigned char*)map;
 
-            // if colliding with player
+    }
 
-            if (enemy[i].isColliding(player)) {
+    close(file);
 
-                player.hurt(enemy[i].getDamage());
+#else
 
+    FILE* file = fopen(fileName, "rb");
 
-                // if player dies
+    if (file == NULL) return false;
 
-                if (player.getHealth() < 1) {
 
-                    endGame = true;
+    fseek(file, 0, SEEK_END);
 
-                }
+    size = ftell(file);
 
-            }
+    fseek(file, 0, SEEK_SET);
 
+    if (size >= (long)sizeof(AssetPackHeader)) {
 
-            // if the enemy has been hit recently, give it i-frames until its damage cooldown is over
+        unsigned char* buffer = new unsigned char[size];
 
-            if (enemy[i].isOnCooldown()) {
+        if (fread(buffer, size, 1, file) == 1) {
 
-                enemy[i].lowerDamageCooldown();
+            data = buffer;
 
+        } else {
 
-                if (enemy[i].getDamageCooldown() < 0) {
+            delete[] buffer;
 
-                    enemy[i].setDamageCooldown(30);
+        }
 
-                    enemy[i].setIsOnCooldown(false);
+    }
 
-                }
+    fclose(file);
 
-            }
+#endif
 
 
-            // special collision detection for beam weapon
+    if (data == NULL) return false;
 
-            if (items.beam.level > -1) {
 
-                // temp variables for center of player
+    // make sure its a pack this version of the game understands before anything points into it
 
-                float centerX = player.getX() + player.getWidth()/2;
+    if (!checkAssetPack(data, size)) {
 
-                float centerY = player.getY() + player.getHeight()/2;
+        releaseAssetPackData(data, size);
 
+        return false;
 
-                // checks if enemy is colliding with the end of the beam, and halfway down the beam (ugly but works)
+    }
 
-                if (enemy[i].isCollidingWithPoint(centerX + items.beam.length[items.beam.level]*cos(player.getAngle()),
 
-                centerY + items.beam.length[items.beam.level]*sin(player.getAngle())) ||
+    assetPack.data = data;
 
-                enemy[i].isCollidingWithPoint(centerX + 0.5*items.beam.length[items.beam.level]*cos(player.getAngle()),
+    assetPack.size = size;
 
-                centerY + 0.5*items.beam.length[items.beam.level]*sin(player.getAngle()))) {
+    assetPack.entries = (const AssetPackEntry*)(data + sizeof(AssetPackHeader));
 
-                    // should not affect the enemy if on damage cooldown
+    assetPack.count = ((const AssetPackHeader*)data)->count;
 
-                    if (!enemy[i].isOnCooldown()) {
+    return true;
 
-                        enemy[i].setIsOnCooldown(true);
+}
 
-                        enemy[i].hurt(items.beam.damage[items.beam.level]);
 
-                    }
+// finds an image in the pack by name (the index is sorted by hash), NULL if it's not there
 
-                }
+const AssetPackEntry* findAsset(const char name[]) {
 
-            }
+    unsigned int hash = hashAssetName(name);
 
 
-            // for each attack on screen
+    int low = 0, high = assetPack.count - 1;
 
-            for (int j = 0; j < attackCounter; j++) {
+    while (low <= high) {
 
-                // checks if enemy is colliding with the attack
+        int middle = (low + high) / 2;
 
-                // should not affect the enemy if on damage cooldown
+        const AssetPackEntry& entry = assetPack.entries[middle];
 
-                if (enemy[i].isColliding(attack[j]) && !enemy[i].isOnCooldown()) {
+        if (entry.nameHash == hash) return &entry;
 
-                    enemy[i].setIsOnCooldown(true);
+        if (entry.nameHash < hash) {
 
-                    enemy[i].hurt(attack[j].getDamage());
+            low = middle + 1;
 
-                    attack[j].hurt(1);
+        } else {
 
-                }
+            high = middle - 1;
 
-            }
+        }
 
+    }
 
-            // if enemy health below 0
+    return NULL;
 
-            if (enemy[i].getHealth() < 1) {
+}
 
 
-                // removes the enemy from the array and updates counters accordingly
+// every sprite the game has loaded, they stay loaded until the game closes
 
-                removeFromArray(enemy, 50, i);
+const int MAX_SPRITES = 48;
 
-                enemyCounter--;
+Sprite sprites[MAX_SPRITES];
 
-                i--;
+int spriteCount = 0;
 
 
-                // grant player XP
+/*
 
-                player.setXp(player.getXp() + 1);
+*   builds the runs of a sprite flipped left to right. each row's runs come out in reverse order,
 
+*   each one moved to the other side and with its colors backwards
 
-                // if player has Lab Report item, heal them on enemy death
+*/
 
-                if (items.report.level > -1) {
+unsigned int* mirrorSpriteRuns(const Sprite& sprite) {
 
-                    player.setHealth(player.getHealth() + items.report.healing[items.report.level]);
+    unsigned int* mirrored = new unsigned int[sprite.words];
 
-                }
 
+    const unsigned int* in = sprite.runs;
 
-                // update score
+    unsigned int* out = mirrored;
 
-                score += 10;
+    for (int row = 0; row < sprite.height; row++) {
 
-            }
+        int runCount = *in++;
 
-        }
 
+        // find how long the row is, the first run goes at the end of it
 
-        // handle logic for each attack on screen
+        const unsigned int* word = in;
 
-        for (int i = 0; i < attackCounter; i++) {
+        for (int run = 0; run < runCount; run++) {
 
-           
+            word += 1 + (*word >> 16);
 
-            // move the attacks and draw each one
+        }
 
-            attack[i].move();
+        int rowWords = word - in;
 
-            attack[i].drawSelf();
 
+        *out = runCount;
 
-            int attackX = attack[i].getX();
+        unsigned int* position = out + 1 + rowWords;
 
-            int attackY = attack[i].getY();
+        for (int run = 0; run < runCount; run++) {
 
+            int start = *in & 0xFFFF;
 
-            // if attack goes off screen or if health below 0, delete the attack
+            int length = *in >> 16;
 
-            if (attack[i].getHealth() < 1 || attackX > WINDOW_WIDTH - attack[i].getWidth() || attackX < 0 || attackY > WINDOW_HEIGHT - attack[i].getHeight() || attackY < 0) {
 
-                // remove from attack array and update counters accordingly
+            position -= 1 + length;
 
-                removeFromArray(attack, 50, i);
+            position[0] = (sprite.width - start - length) | length << 16;
 
-                attackCounter--;
+            for (int i = 0; i < length; i++) {
 
-                i--;
+                position[1 + i] = in[length - i];
 
             }
 
+            in += 1 + length;
+
         }
 
+        out += 1 + rowWords;
 
-        // if the player has enough xp to level up
+    }
 
-        if (xpToNextLevel - player.getXp() <= 0) {
 
+    return mirrored;
 
-            // reset the player xp and increments level
+}
 
-            player.setXp(0);
 
-            player.setLevel(player.getLevel() + 1);
+/*
 
+*   reads the sprite with this file name into sprite, from the asset pack if it's in there, otherwise from the .pic.
 
-            // only prompt new items if there are new items to give
+*   it doesn't touch sprites[], so the asset loader can call it from its own thread. returns false if the file is missing
 
-            if (player.getLevel() < 15) promptItemMenu(items);
+*/
 
+bool loadSprite(const char name[], Sprite& sprite) {
 
-            // update xp requirement and make enemies spawn more frequently
+    sprite.mirrored = false;
 
-            xpToNextLevel = 5 + 5*player.getLevel();
 
-            enemySpawnCooldown = 4000 - 200*player.getLevel();
+    const AssetPackEntry* entry = findAsset(name);
 
-            if (enemySpawnCooldown < 1000) enemySpawnCooldown = 1000;
+    if (entry != NULL) {
 
+        sprite.width = entry->width;
 
-            // update score
+        sprite.height = entry->height;
 
-            score += 100;
+        sprite.runs = (const unsigned int*)(assetPack.data + entry->offset);
 
-        }
+        sprite.words = entry->words;
 
+    } else {
+
+        FILE* file = fopen(name, "r");
+
+        if (file == NULL) return false;
+
+
+        // nothing the game draws is bigger than the screen, so anything else is a broken file
+
+        if (fscanf(file, "%d %d", &sprite.height, &sprite.width) != 2 || sprite.width <= 0 || sprite.height <= 0 ||
+
+            sprite.width > WINDOW_WIDTH || sprite.height > WINDOW_HEIGHT) {
+
+            fclose(file);
+
+            return false;
+
+        }
+
+
+        unsigned int* pixels = new unsigned int[sprite.width * sprite.height];
+
+        for (int i = 0; i < sprite.width * sprite.height; i++) {
+
+            int color;
+
+            if (fscanf(file, "%d", &color) != 1) {
+
+                // cut off before the last pixel
+
+                delete[] pixels;
+
+                fclose(file);
+
+                return NULL;
+
+            }
+
+            pixels[i] = color;
+
+        }
+
+        fclose(file);
+
+
+        // keep just the runs
+
+        sprite.words = encodeSpriteRuns(pixels, sprite.width, sprite.height, NULL);
+
+        unsigned int* runs = new unsigned int[sprite.words];
+
+        encodeSpriteRuns(pixels, sprite.width, sprite.height, runs);
+
+        sprite.runs = runs;
+
+        delete[] pixels;
+
+    }
+
+
+    strcpy(sprite.name, name);
+
+    return true;
+
+}
+
+
+// frees the runs loadSprite made for a sprite that isn't going into sprites[]. runs from the pack are part of the file
+
+void freeLoadedSprite(Sprite& sprite) {
+
+    const unsigned char* runs = (const unsigned char*)sprite.runs;
+
+    bool inPack = assetPack.data != NULL && runs >= assetPack.data && runs < assetPack.data + assetPack.size;
+
+    if (!inPack) delete[] sprite.runs;
+
+    sprite.runs = NULL;
+
+}
+
+
+#ifdef INDEXED_COLOR
+
+
+/*
+
+*   builds the runs of a sprite with palette indexes in place of colors. bytes instead of words: for each row a
+
+*   2 byte run count, then for each run a 2 byte start, 2 byte length and one index per pixel (2 byte numbers are low byte first)
+
+*/
+
+unsigned char* indexSpriteRuns(const Sprite& sprite) {
+
+    // same number of runs and pixels, just smaller
+
+    int bytes = 0;
+
+    const unsigned int* word = sprite.runs;
+
+    for (int row = 0; row < sprite.height; row++) {
+
+        int runCount = *word++;
+
+        bytes += 2;
+
+        for (int run = 0; run < runCount; run++) {
+
+            int length = *word >> 16;
+
+            bytes += 4 + length;
+
+            word += 1 + length;
+
+        }
+
+    }
+
+
+    unsigned char* indexed = new unsigned char[bytes];
+
+    unsigned char* out = indexed;
+
+    word = sprite.runs;
+
+    for (int row = 0; row < sprite.height; row++) {
+
+        int runCount = *word++;
+
+        *out++ = runCount & 0xFF;
+
+        *out++ = runCount >> 8;
+
+        for (int run = 0; run < runCount; run++) {
+
+            int start = *word & 0xFFFF;
+
+            int length = *word >> 16;
+
+            *out++ = start & 0xFF;
+
+            *out++ = start >> 8;
+
+            *out++ = length & 0xFF;
+
+            *out++ = length >> 8;
+
+            for (int i = 0; i < length; i++) {
+
+                *out++ = toPixel(word[1 + i]);
+
+            }
+
+            word += 1 + length;
+
+        }
+
+    }
+
+    return indexed;
+
+}
+
+
+// gets a sprite that was just put in sprites[] ready to draw, on the game's thread since it adds to the palette
+
+void finishSprite(Sprite& sprite) {
+
+    sprite.indexed = indexSpriteRuns(sprite);
+
+}
+
+
+#else
+
+
+inline void finishSprite(Sprite&) {}
+
+
+#endif
+
+
+#ifdef ASYNC_LOADING
+
+
+// how many sprites can be waiting to be loaded (or waiting to be picked up) at once
+
+const int PRELOAD_SLOTS = 24;
+
+
+enum PreloadState {PRELOAD_FREE, PRELOAD_QUEUED, PRELOAD_DONE, PRELOAD_FAILED};
+
+
+/*
+
+*   a sprite asked for ahead of time. the game fills in name and queues it, the loader thread loads it into sprite
+
+*   and marks it done, then the game moves it into sprites[]. only one side owns a slot at a time (state says which),
+
+*   so state is the only part that has to be atomic
+
+*/
+
+struct Preload {
+
+    char name[30];
+
+    Sprite sprite;
+
+    std::atomic<int> state;
+
+};
+
+
+struct AssetLoader {
+
+    Preload slots[PRELOAD_SLOTS];
+
+    std::mutex lock;
+
+    std::condition_variable wake;
+
+    bool running;
+
+    std::thread thread;
+
+};
+
+
+AssetLoader assetLoader;
+
+
+/*
+
+*   runs on the loader thread, loads every queued slot and then sleeps until more get queued.
+
+*   sprites from the asset pack are only pointers into the mapped file, so it reads through them too,
+
+*   so the OS has their pages in memory before the first time they get drawn
+
+*/
+
+void assetLoaderThread() {
+
+    std::unique_lock<std::mutex> guard(assetLoader.lock);
+
+    while (assetLoader.running) {
+
+        bool loadedAny = false;
+
+        for (int i = 0; i < PRELOAD_SLOTS; i++) {
+
+            Preload& slot = assetLoader.slots[i];
+
+            if (slot.state.load(std::memory_order_acquire) != PRELOAD_QUEUED) continue;
+
+
+            // don't hold the lock while reading files
+
+            guard.unlock();
+
+            bool found = loadSprite(slot.name, slot.sprite);
+
+            if (found) {
+
+                volatile unsigned int touch = 0;
+
+                for (int word = 0; word < slot.sprite.words; word += 1024) {
+
+                    touch += slot.sprite.runs[word];
+
+                }
+
+            }
+
+            slot.state.store(found ? PRELOAD_DONE : PRELOAD_FAILED, std::memory_order_release);
+
+            guard.lock();
+
+
+            loadedAny = true;
+
+        }
+
+        if (!loadedAny) assetLoader.wake.wait(guard);
+
+    }
+
+}
+
+
+// starts the loader thread, call once before anything gets preloaded
+
+void startAssetLoader() {
+
+    for (int i = 0; i < PRELOAD_SLOTS; i++) {
+
+        assetLoader.slots[i].state.store(PRELOAD_FREE);
+
+    }
+
+    assetLoader.running = true;
+
+    assetLoader.thread = std::thread(assetLoaderThread);
+
+}
+
+
+// lets the loader finish the sprite it's on and stops it
+
+void stopAssetLoader() {
+
+    {
+
+        std::lock_guard<std::mutex> guard(assetLoader.lock);
+
+        assetLoader.running = false;
+
+    }
+
+    assetLoader.wake.notify_one();
+
+    assetLoader.thread.join();
+
+}
+
+
+/*
+
+*   queues a sprite to be loaded in the background. does nothing if it's already loaded or queued,
+
+*   or if every slot is taken (then it just gets loaded the normal way when it's needed)
+
+*/
+
+void preloadSprite(const char name[]) {
+
+    for (int i = 0; i < spriteCount; i++) {
+
+        if (!sprites[i].mirrored && strcmp(sprites[i].name, name) == 0) return;
+
+    }
+
+
+    Preload* empty = NULL;
+
+    for (int i = 0; i < PRELOAD_SLOTS; i++) {
+
+        Preload& slot = assetLoader.slots[i];
+
+        if (slot.state.load(std::memory_order_acquire) == PRELOAD_FREE) {
+
+            if (empty == NULL) empty = &slot;
+
+        } else if (strcmp(slot.name, name) == 0) {
+
+            return;
+
+        }
+
+    }
+
+    if (empty == NULL) return;
+
+
+    strcpy(empty->name, name);
+
+    {
+
+        std::lock_guard<std::mutex> guard(assetLoader.lock);
+
+        empty->state.store(PRELOAD_QUEUED, std::memory_order_release);
+
+    }
+
+    assetLoader.wake.notify_one();
+
+}
+
+
+/*
+
+*   moves every sprite the loader has finished into sprites[] and frees its slot. if name is still being loaded
+
+*   this waits for it, since the game needs it right now anyway
+
+*/
+
+void collectPreloadedSprites(const char name[]) {
+
+    for (int i = 0; i < PRELOAD_SLOTS; i++) {
+
+        Preload& slot = assetLoader.slots[i];
+
+        int state = slot.state.load(std::memory_order_acquire);
+
+        if (state == PRELOAD_FREE) continue;
+
+
+        if (state == PRELOAD_QUEUED) {
+
+            if (strcmp(slot.name, name) != 0) continue;
+
+            while ((state = slot.state.load(std::memory_order_acquire)) == PRELOAD_QUEUED) {
+
+                std::this_thread::yield();
+
+            }
+
+        }
+
+
+        if (state == PRELOAD_DONE && spriteCount < MAX_SPRITES) {
+
+            sprites[spriteCount] = slot.sprite;
+
+            finishSprite(sprites[spriteCount++]);
+
+        } else if (state == PRELOAD_DONE) {
+
+            // no room for it, so it's thrown away and the slot is used again
+
+            fprintf(stderr, "no room for %s, all %d sprites are in use\n", slot.name, MAX_SPRITES);
+
+            freeLoadedSprite(slot.sprite);
+
+        }
+
+        slot.state.store(PRELOAD_FREE, std::memory_order_release);
+
+    }
+
+}
+
+
+#else
+
+
+// how many sprites can be waiting to be loaded at once
+
+const int PRELOAD_SLOTS = 24;
+
+
+// no loader thread, so sprites asked for ahead of time wait here until the scene loop has nothing else
+
+// to do and loads them itself (see loadInBackground). anything still here when it's needed is loaded then
+
+char preloadQueue[PRELOAD_SLOTS][30];
+
+int preloadCount = 0;
+
+
+inline void startAssetLoader() {}
+
+inline void stopAssetLoader() {}
+
+inline void collectPreloadedSprites(const char[]) {}
+
+
+// queues a sprite to be loaded while the game is waiting on a touch, unless it's already loaded or queued
+
+void preloadSprite(const char name[]) {
+
+    for (int i = 0; i < spriteCount; i++) {
+
+        if (!sprites[i].mirrored && strcmp(sprites[i].name, name) == 0) return;
+
+    }
+
+    for (int i = 0; i < preloadCount; i++) {
+
+        if (strcmp(preloadQueue[i], name) == 0) return;
+
+    }
+
+    if (preloadCount >= PRELOAD_SLOTS) return;
+
+
+    strcpy(preloadQueue[preloadCount++], name);
+
+}
+
+
+#endif
+
+
+/*
+
+*   returns the sprite with this file name (flipped left to right if mirrored), loading it the first time it's asked for
+
+*   (see loadSprite) unless the asset loader already has. mirrored ones are made from the normal one,
+
+*   so there is no file for them. returns NULL if the file is missing or there's no room left
+
+*/
+
+Sprite* getSprite(const char name[], bool mirrored = false) {
+
+    collectPreloadedSprites(name);
+
+
+    for (int i = 0; i < spriteCount; i++) {
+
+        if (sprites[i].mirrored == mirrored && strcmp(sprites[i].name, name) == 0) return &sprites[i];
+
+    }
+
+
+    if (mirrored) {
+
+        Sprite* original = getSprite(name);
+
+        if (original == NULL || spriteCount >= MAX_SPRITES) return NULL;
+
+
+        Sprite& sprite = sprites[spriteCount++];
+
+        sprite = *original;
+
+        sprite.mirrored = true;
+
+        sprite.runs = mirrorSpriteRuns(*original);
+
+        finishSprite(sprite);
+
+        return &sprite;
+
+    }
+
+
+    if (spriteCount >= MAX_SPRITES) return NULL;
+
+
+    Sprite& sprite = sprites[spriteCount];
+
+    if (!loadSprite(name, sprite)) return NULL;
+
+    finishSprite(sprite);
+
+    spriteCount++;
+
+    return &sprite;
+
+}
+
+
+/*
+
+*   one piece of loading for when the scene loop is waiting on a touch. with the loader thread that's just moving
+
+*   what it has finished into sprites[], without it the oldest queued sprite gets loaded right here, so the
+
+*   sprites for the next screen load while a menu is up instead of when it's tapped. returns false if the loop
+
+*   can go to sleep instead
+
+*/
+
+#ifdef ASYNC_LOADING
+
+bool loadInBackground() {
+
+    collectPreloadedSprites("");
+
+    return false;
+
+}
+
+#else
+
+bool loadInBackground() {
+
+    if (preloadCount == 0) return false;
+
+
+    getSprite(preloadQueue[0]);
+
+    preloadCount--;
+
+    for (int i = 0; i < preloadCount; i++) {
+
+        strcpy(preloadQueue[i], preloadQueue[i + 1]);
+
+    }
+
+    return true;
+
+}
+
+#endif
+
+
+/*
+
+*   copy of the screen in memory. the game draws each frame into pixels, then presentFrame sends
+
+*   only the pixels that are different from what the LCD is showing (shown) instead of clearing and redrawing everything
+
+*/
+
+struct FrameBuffer {
+
+    Pixel pixels[WINDOW_HEIGHT][WINDOW_WIDTH];
+
+    Pixel shown[WINDOW_HEIGHT][WINDOW_WIDTH];
+
+};
+
+
+FrameBuffer screen;
+
+
+// puts one pixel in the frame, ignoring anything off screen
+
+void drawPixel(int x, int y, Pixel pixel) {
+
+    if (x < 0 || x >= WINDOW_WIDTH || y < 0 || y >= WINDOW_HEIGHT) return;
+
+    screen.pixels[y][x] = pixel;
+
+}
+
+
+// fills a rectangle in the frame, clipped to the screen
+
+void fillRectangle(int x, int y, int width, int height, unsigned int color) {
+
+    Pixel pixel = toPixel(color);
+
+    int x0 = x < 0 ? 0 : x;
+
+    int y0 = y < 0 ? 0 : y;
+
+    int x1 = x + width > WINDOW_WIDTH ? WINDOW_WIDTH : x + width;
+
+    int y1 = y + height > WINDOW_HEIGHT ? WINDOW_HEIGHT : y + height;
+
+
+    for (int row = y0; row < y1; row++) {
+
+        for (int col = x0; col < x1; col++) {
+
+            screen.pixels[row][col] = pixel;
+
+        }
+
+    }
+
+}
+
+
+// draws a line into the frame (bresenham's algorithm)
+
+void drawLine(int x0, int y0, int x1, int y1, unsigned int color) {
+
+    Pixel pixel = toPixel(color);
+
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+
+    int dy = y1 > y0 ? y0 - y1 : y1 - y0;
+
+    int stepX = x0 < x1 ? 1 : -1;
+
+    int stepY = y0 < y1 ? 1 : -1;
+
+    int error = dx + dy;
+
+
+    while (true) {
+
+        drawPixel(x0, y0, pixel);
+
+        if (x0 == x1 && y0 == y1) break;
+
+
+        int error2 = 2 * error;
+
+        if (error2 >= dy) {
+
+            error += dy;
+
+            x0 += stepX;
+
+        }
+
+        if (error2 <= dx) {
+
+            error += dx;
+
+            y0 += stepY;
+
+        }
+
+    }
+
+}
+
+
+/*
+
+*   copies a run of sprite pixels into the frame. there is no mask to apply, the see-through pixels were taken
+
+*   out when the runs were made, so all that's left is the copy. on PCs it goes 32 (AVX2) or 16 (SSE2) bytes
+
+*   at a time, and the last few bytes are one more copy that overlaps the one before it rather than a pixel at a time
+
+*/
+
+inline void copyPixels(Pixel* destination, const Pixel* source, int count) {
+
+    unsigned char* to = (unsigned char*)destination;
+
+    const unsigned char* from = (const unsigned char*)source;
+
+    int bytes = count * (int)sizeof(Pixel);
+
+
+#if defined(__AVX2__)
+
+    if (bytes >= 32) {
+
+        for (int i = 0; i < bytes - 32; i += 32) {
+
+            _mm256_storeu_si256((__m256i*)(to + i), _mm256_loadu_si256((const __m256i*)(from + i)));
+
+        }
+
+        _mm256_storeu_si256((__m256i*)(to + bytes - 32), _mm256_loadu_si256((const __m256i*)(from + bytes - 32)));
+
+        return;
+
+    }
+
+#endif
+
+#if defined(__SSE2__)
+
+    if (bytes >= 16) {
+
+        for (int i = 0; i < bytes - 16; i += 16) {
+
+            _mm_storeu_si128((__m128i*)(to + i), _mm_loadu_si128((const __m128i*)(from + i)));
+
+        }
+
+        _mm_storeu_si128((__m128i*)(to + bytes - 16), _mm_loadu_si128((const __m128i*)(from + bytes - 16)));
+
+        return;
+
+    }
+
+#else
+
+    if (bytes > 16) {
+
+        memcpy(to, from, bytes);
+
+        return;
+
+    }
+
+#endif
+
+
+    // under a vector is two fixed size copies that overlap (a memcpy of a fixed 8 or 4 bytes is one move, not a call)
+
+    if (bytes >= 8) {
+
+        memcpy(to, from, 8);
+
+        memcpy(to + bytes - 8, from + bytes - 8, 8);
+
+        return;
+
+    }
+
+    if (bytes >= 4) {
+
+        memcpy(to, from, 4);
+
+        memcpy(to + bytes - 4, from + bytes - 4, 4);
+
+        return;
+
+    }
+
+    for (int i = 0; i < count; i++) destination[i] = source[i];
+
+}
+
+
+// the copy the blitter used before copyPixels, kept so BENCHMARK can compare them
+
+inline void copyPixelsByHand(Pixel* destination, const Pixel* source, int count) {
+
+    // short runs (most of the weapon sprites) are quicker copied by hand than through a memcpy call
+
+    if (count <= 8) {
+
+        for (int i = 0; i < count; i++) destination[i] = source[i];
+
+    } else {
+
+        memcpy(destination, source, count * sizeof(Pixel));
+
+    }
+
+}
+
+
+/*
+
+*   draws a sprite into the frame with its top left corner at (x, y), each run cut down to the part that is
+
+*   on screen and then copied in with copy. use drawSprite, this is only separate so BENCHMARK can swap the copy
+
+*/
+
+#ifdef INDEXED_COLOR
+
+template <void (*copy)(Pixel*, const Pixel*, int)>
+
+void blitSprite(Sprite* sprite, int x, int y) {
+
+    if (sprite == NULL) return;
+
+
+    const unsigned char* byte = sprite->indexed;
+
+    for (int row = 0; row < sprite->height; row++) {
+
+        int screenY = y + row;
+
+        if (screenY >= WINDOW_HEIGHT) break;
+
+
+        int runCount = byte[0] | byte[1] << 8;
+
+        byte += 2;
+
+        for (int run = 0; run < runCount; run++) {
+
+            int start = byte[0] | byte[1] << 8;
+
+            int length = byte[2] | byte[3] << 8;
+
+            const unsigned char* indexes = byte + 4;
+
+            byte += 4 + length;
+
+
+            if (screenY < 0) continue;
+
+
+            // clip the run to the screen
+
+            int left = x + start;
+
+            int right = left + length;
+
+            int skip = left < 0 ? -left : 0;
+
+            if (right > WINDOW_WIDTH) right = WINDOW_WIDTH;
+
+            if (left + skip >= right) continue;
+
+
+            copy(&screen.pixels[screenY][left + skip], indexes + skip, right - left - skip);
+
+        }
+
+    }
+
+}
+
+#else
+
+template <void (*copy)(Pixel*, const Pixel*, int)>
+
+void blitSprite(Sprite* sprite, int x, int y) {
+
+    if (sprite == NULL) return;
+
+
+    const unsigned int* word = sprite->runs;
+
+    for (int row = 0; row < sprite->height; row++) {
+
+        int screenY = y + row;
+
+        if (screenY >= WINDOW_HEIGHT) break;
+
+
+        int runCount = *word++;
+
+        for (int run = 0; run < runCount; run++) {
+
+            int start = *word & 0xFFFF;
+
+            int length = *word >> 16;
+
+            const unsigned int* colors = word + 1;
+
+            word += 1 + length;
+
+
+            if (screenY < 0) continue;
+
+
+            // clip the run to the screen
+
+            int left = x + start;
+
+            int right = left + length;
+
+            int skip = left < 0 ? -left : 0;
+
+            if (right > WINDOW_WIDTH) right = WINDOW_WIDTH;
+
+            if (left + skip >= right) continue;
+
+
+            copy(&screen.pixels[screenY][left + skip], colors + skip, right - left - skip);
+
+        }
+
+    }
+
+}
+
+#endif
+
+
+// draws a sprite into the frame with its top left corner at (x, y)
+
+void drawSprite(Sprite* sprite, int x, int y) {
+
+    blitSprite<copyPixels>(sprite, x, y);
+
+}
+
+
+#ifdef BENCHMARK
+
+const int BENCHMARK_BLITS = 1000000;
+
+
+// the sprite of each size the game draws: enemies, marbles, airfoils and the player
+
+const char BENCHMARK_SPRITES[4][30] = {"Enemy1FEH.pic", "MarbleFEH.pic", "AirfoilFEH.pic", "PlayerFEH.pic"};
+
+
+const int BENCHMARK_ROUNDS = 3;
+
+
+// draws a sprite BENCHMARK_BLITS times all over the screen and past its edges, returns nanoseconds per blit
+
+// (the best of BENCHMARK_ROUNDS tries, so something else running for a moment doesn't count against it)
+
+template <void (*copy)(Pixel*, const Pixel*, int)>
+
+double timeBlits(Sprite* sprite) {
+
+    int spanX = WINDOW_WIDTH + 2 * sprite->width;
+
+    int spanY = WINDOW_HEIGHT + 2 * sprite->height;
+
+
+    unsigned long best = 0;
+
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+
+        unsigned long start = TimeNowMSec();
+
+        for (int i = 0; i < BENCHMARK_BLITS; i++) {
+
+            blitSprite<copy>(sprite, (i * 7) % spanX - sprite->width, (i * 13) % spanY - sprite->height);
+
+        }
+
+        unsigned long elapsed = TimeNowMSec() - start;
+
+        if (round == 0 || elapsed < best) best = elapsed;
+
+    }
+
+    return best * 1e6 / BENCHMARK_BLITS;
+
+}
+
+
+/*
+
+*   times copyPixels against copying by hand for each sprite size, and checks both drew the same frame
+
+*/
+
+void benchmarkBlits() {
+
+    for (int i = 0; i < 4; i++) {
+
+        Sprite* sprite = getSprite(BENCHMARK_SPRITES[i]);
+
+        if (sprite == NULL) continue;
+
+
+        // the by hand frame goes in screen.shown to compare against afterwards
+
+        memset(screen.pixels, 0, sizeof(screen.pixels));
+
+        double byHand = timeBlits<copyPixelsByHand>(sprite);
+
+        memcpy(screen.shown, screen.pixels, sizeof(screen.pixels));
+
+
+        memset(screen.pixels, 0, sizeof(screen.pixels));
+
+        double vector = timeBlits<copyPixels>(sprite);
+
+        bool same = memcmp(screen.shown, screen.pixels, sizeof(screen.pixels)) == 0;
+
+
+        printf("blit %s %dx%d: by hand %.1f ns, copyPixels %.1f ns (%.2fx)%s\n", sprite->name, sprite->width, sprite->height,
+
+               byHand, vector, vector > 0 ? byHand / vector : 0.0, same ? "" : " FRAMES DIFFER");
+
+    }
+
+}
+
+#endif
+
+
+// makes presentFrame redraw a rectangle next time (used after drawing text or menus straight to the LCD)
+
+void invalidateRectangle(int x, int y, int width, int height) {
+
+    int x0 = x < 0 ? 0 : x;
+
+    int y0 = y < 0 ? 0 : y;
+
+    int x1 = x + width > WINDOW_WIDTH ? WINDOW_WIDTH : x + width;
+
+    int y1 = y + height > WINDOW_HEIGHT ? WINDOW_HEIGHT : y + height;
+
+
+    for (int row = y0; row < y1; row++) {
+
+        for (int col = x0; col < x1; col++) {
+
+            screen.shown[row][col] = NO_PIXEL;
+
+        }
+
+    }
+
+}
+
+
+void invalidateScreen() {
+
+    invalidateRectangle(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+}
+
+
+/*
+
+*   sends the frame to the LCD. each row is walked for pixels that changed since the last frame,
+
+*   and changed pixels of the same color next to each other are sent as one horizontal line
+
+*/
+
+void presentFrame() {
+
+    Pixel currentColor = NO_PIXEL;
+
+
+    for (int row = 0; row < WINDOW_HEIGHT; row++) {
+
+        Pixel* pixels = screen.pixels[row];
+
+        Pixel* shown = screen.shown[row];
+
+
+        int col = 0;
+
+        while (col < WINDOW_WIDTH) {
+
+            // skip what the LCD already has
+
+            if (pixels[col] == shown[col]) {
+
+                col++;
+
+                continue;
+
+            }
+
+
+            // run of changed pixels that are all the same color
+
+            Pixel color = pixels[col];
+
+            int start = col;
+
+            while (col < WINDOW_WIDTH && pixels[col] == color && shown[col] != color) {
+
+                shown[col] = color;
+
+                col++;
+
+            }
+
+
+            if (color != currentColor) {
+
+                LCD.SetFontColor(pixelColor(color));
+
+                currentColor = color;
+
+            }
+
+            if (col - start == 1) {
+
+                LCD.DrawPixel(start, row);
+
+            } else {
+
+                LCD.DrawHorizontalLine(row, start, col - 1);
+
+            }
+
+        }
+
+    }
+
+}
+
+
+/*
+
+*   draws a sprite straight onto the LCD, for menus that don't go through the frame.
+
+*   runs of the same color go out as one line like in presentFrame
+
+*/
+
+void drawSpriteToLCD(Sprite* sprite, int x, int y) {
+
+    if (sprite == NULL) return;
+
+
+    const unsigned int* word = sprite->runs;
+
+    for (int row = 0; row < sprite->height; row++) {
+
+        int runCount = *word++;
+
+        for (int run = 0; run < runCount; run++) {
+
+            int start = *word & 0xFFFF;
+
+            int length = *word >> 16;
+
+            const unsigned int* colors = word + 1;
+
+            word += 1 + length;
+
+
+            // pixels of the same color next to each other go out as one line
+
+            int col = 0;
+
+            while (col < length) {
+
+                unsigned int color = colors[col];
+
+                int first = col;
+
+                while (col < length && colors[col] == color) {
+
+                    col++;
+
+                }
+
+
+                LCD.SetFontColor(color);
+
+                if (col - first == 1) {
+
+                    LCD.DrawPixel(x + start + first, y + row);
+
+                } else {
+
+                    LCD.DrawHorizontalLine(y + row, x + start + first, x + start + col - 1);
+
+                }
+
+            }
+
+        }
+
+    }
+
+
+    // the LCD doesn't match the frame there anymore
+
+    invalidateRectangle(x, y, sprite->width, sprite->height);
+
+}
+
+
+// define the structs for the weapons, including all the values that will change as they level up
+
+struct Marble {
+
+    int level = -1;
+
+    int damage[3] = {1, 2, 3};
+
+    int cooldown[3] = {3000, 2000, 1000};
+
+};
+
+struct Airfoil {
+
+    int level = -1;
+
+    int damage[3] = {1, 3, 5};
+
+    int cooldown[3] = {2000, 1750, 1500};
+
+    float moveBonus[3] = {0.2, 0.4, 0.6};
+
+};
+
+struct Beam {
+
+    int level = -1;
+
+    int damage[3] = {1, 2, 3};
+
+    int length[3] = {40, 50, 70};
+
+    int color[3] = {SILVER, BROWN, GRAY};
+
+};
+
+struct Circuit {
+
+    int level = -1;
+
+    int damage[3] = {1, 3, 5};
+
+    int cooldown[3] = {10000, 9000, 8000};
+
+    int hits[3] = {2, 4, 6};
+
+};
+
+struct Report {
+
+    int level = -1;
+
+    int healing[3] = {20, 45, 80};
+
+};
+
+
+// define the Items struct that will be used to hold all of the player's items
+
+struct Items {
+
+    Marble marble;
+
+    Airfoil airfoil;
+
+    Beam beam;
+
+    Circuit circuit;
+
+    Report report;
+
+};
+
+
+// the highest level an item goes to (levels start at -1 for not picked yet)
+
+const int MAX_ITEM_LEVEL = 2;
+
+
+// what each item's level up cards are called, by item id (see TelemetryFormat.h)
+
+const char ITEM_CARD_NAMES[ITEM_COUNT][10] = {"marble", "airfoil", "beam", "circuit", "report"};
+
+
+// points at an item's level, by item id
+
+int* itemLevel(Items& items, int item) {
+
+    switch (item) {
+
+        case ITEM_MARBLE: return &items.marble.level;
+
+        case ITEM_AIRFOIL: return &items.airfoil.level;
+
+        case ITEM_BEAM: return &items.beam.level;
+
+        case ITEM_CIRCUIT: return &items.circuit.level;
+
+        default: return &items.report.level;
+
+    }
+
+}
+
+
+// file name of the card that offers an item at its next level, like "marbleItem2FEH.pic" for a level 0 marble
+
+void itemCardName(Items& items, int item, char name[]) {
+
+    sprintf(name, "%sItem%dFEH.pic", ITEM_CARD_NAMES[item], *itemLevel(items, item) + 2);
+
+}
+
+
+// every sprite an entity can use, entities keep an index into this instead of the whole file name.
+
+// frames of an animation are next to each other, so a sprite sheet is just where its first frame is
+
+enum EntitySprite {
+
+    SPRITE_PLAYER_START, SPRITE_PLAYER_WALK, SPRITE_PLAYER,
+
+    SPRITE_ENEMY1, SPRITE_ENEMY2, SPRITE_ENEMY3, SPRITE_ENEMY4, SPRITE_ENEMY5,
+
+    SPRITE_MARBLE, SPRITE_AIRFOIL, SPRITE_CIRCUIT,
+
+    ENTITY_SPRITE_COUNT
+
+};
+
+const char ENTITY_SPRITES[ENTITY_SPRITE_COUNT][30] = {
+
+    "playerFEH.pic", "PlayerWalkFEH.pic", "PlayerFEH.pic",
+
+    "Enemy1FEH.pic", "Enemy2FEH.pic", "Enemy3FEH.pic", "Enemy4FEH.pic", "Enemy5FEH.pic",
+
+    "MarbleFEH.pic", "AirfoilFEH.pic", "CircuitFEH.pic"
+
+};
+
+
+/*
+
+*   entities never hold a sprite themselves, they share the ones in sprites[] through a 16 bit handle
+
+*   (where the sprite sits in sprites[]). each entity sprite is looked up by name once per game, both ways round,
+
+*   instead of every time it is drawn
+
+*/
+
+typedef unsigned short SpriteHandle;
+
+const SpriteHandle NO_SPRITE = 0xFFFF;
+
+SpriteHandle entitySpriteHandles[ENTITY_SPRITE_COUNT][2];
+
+
+// the handle of a loaded sprite, NO_SPRITE for NULL
+
+inline SpriteHandle spriteHandle(Sprite* sprite) {
+
+    return sprite == NULL ? NO_SPRITE : (SpriteHandle)(sprite - sprites);
+
+}
+
+
+// loads every entity sprite and its mirrored version, and remembers where they are
+
+void loadEntitySprites() {
+
+    for (int i = 0; i < ENTITY_SPRITE_COUNT; i++) {
+
+        for (int mirrored = 0; mirrored < 2; mirrored++) {
+
+            entitySpriteHandles[i][mirrored] = spriteHandle(getSprite(ENTITY_SPRITES[i], mirrored));
+
+        }
+
+    }
+
+}
+
+
+/*
+
+*   queues what a game needs from the start (the background and every entity sprite) to be loaded in the background.
+
+*   call it at the main menu, so by the time play is pressed they're already loaded
+
+*/
+
+void preloadGameSprites() {
+
+    preloadSprite("BGFEH.pic");
+
+    for (int i = 0; i < ENTITY_SPRITE_COUNT; i++) {
+
+        preloadSprite(ENTITY_SPRITES[i]);
+
+    }
+
+}
+
+
+/*
+
+*   queues the card each item would show at the next level up, so the level up menu never waits on them
+
+*/
+
+void preloadItemCards(Items& items) {
+
+    for (int item = 0; item < ITEM_COUNT; item++) {
+
+        if (*itemLevel(items, item) >= MAX_ITEM_LEVEL) continue;
+
+
+        char name[30];
+
+        itemCardName(items, item, name);
+
+        preloadSprite(name);
+
+    }
+
+}
+
+
+// what gets drawn over what, lowest first
+
+enum DrawLayer {LAYER_BACKGROUND, LAYER_BEAM, LAYER_ENEMIES, LAYER_HIT_FLASH, LAYER_ATTACKS, LAYER_PLAYER, LAYER_COUNT};
+
+
+enum DrawKind {DRAW_SPRITE, DRAW_RECTANGLE, DRAW_LINE};
+
+
+// one thing to draw this frame
+
+struct DrawCommand {
+
+    unsigned short key; // layer in the top 4 bits and sprite handle in the rest, the list is sorted by this
+
+    unsigned short kind;
+
+    short x, y;
+
+    short x1, y1; // rectangles: width and height, lines: the other end
+
+    unsigned int color; // rectangles and lines
+
+};
+
+
+// draws per frame, everything on screen at once is about 160 (the capacity benchmark draws a lot more)
+
+#ifdef BENCHMARK
+
+const int MAX_DRAW_COMMANDS = 16384;
+
+#else
+
+const int MAX_DRAW_COMMANDS = 256;
+
+#endif
+
+
+/*
+
+*   the frame's draws. the game only adds commands while it works out the frame, then drawDrawList sorts them by
+
+*   layer and sprite and draws them all in one go. so the draw order is always the same no matter what order things
+
+*   were added in, and all the draws of one sprite happen together
+
+*/
+
+struct DrawList {
+
+    int count;
+
+    DrawCommand commands[MAX_DRAW_COMMANDS];
+
+    unsigned short order[MAX_DRAW_COMMANDS]; // sorted command indexes
+
+    unsigned short scratch[MAX_DRAW_COMMANDS];
+
+};
+
+
+DrawList drawList;
+
+
+// adds a command, dropped if the list is full
+
+void addDrawCommand(DrawList& list, int layer, SpriteHandle sprite, int kind, int x, int y, int x1, int y1, unsigned int color) {
+
+    if (list.count >= MAX_DRAW_COMMANDS) return;
+
+    list.commands[list.count++] = {(unsigned short)(layer << 12 | (sprite & 0xFFF)), (unsigned short)kind, (short)x, (short)y, (short)x1, (short)y1, color};
+
+}
+
+
+void drawSpriteCommand(DrawList& list, int layer, SpriteHandle sprite, int x, int y) {
+
+    if (sprite == NO_SPRITE) return;
+
+    addDrawCommand(list, layer, sprite, DRAW_SPRITE, x, y, 0, 0, 0);
+
+}
+
+void drawRectangleCommand(DrawList& list, int layer, int x, int y, int width, int height, unsigned int color) {
+
+    addDrawCommand(list, layer, NO_SPRITE, DRAW_RECTANGLE, x, y, width, height, color);
+
+}
+
+void drawLineCommand(DrawList& list, int layer, int x0, int y0, int x1, int y1, unsigned int color) {
+
+    addDrawCommand(list, layer, NO_SPRITE, DRAW_LINE, x0, y0, x1, y1, color);
+
+}
+
+
+/*
+
+*   sorts the commands by key (radix sort, one pass per byte, each pass keeps the order from the one before so
+
+*   equal keys stay in the order they were added), draws them into the frame and empties the list
+
+*/
+
+void drawDrawList(DrawList& list) {
+
+    for (int i = 0; i < list.count; i++) {
+
+        list.order[i] = i;
+
+    }
+
+
+    unsigned short* from = list.order;
+
+    unsigned short* to = list.scratch;
+
+    for (int shift = 0; shift < 16; shift += 8) {
+
+        int starts[257] = {};
+
+        for (int i = 0; i < list.count; i++) {
+
+            starts[((list.commands[i].key >> shift) & 0xFF) + 1]++;
+
+        }
+
+        for (int i = 0; i < 256; i++) {
+
+            starts[i + 1] += starts[i];
+
+        }
+
+        for (int i = 0; i < list.count; i++) {
+
+            int index = from[i];
+
+            to[starts[(list.commands[index].key >> shift) & 0xFF]++] = index;
+
+        }
+
+
+        unsigned short* swap = from;
+
+        from = to;
+
+        to = swap;
+
+    }
+
+
+    // an even number of passes, so the sorted order ended up back in order
+
+    for (int i = 0; i < list.count; i++) {
+
+        const DrawCommand& command = list.commands[list.order[i]];
+
+        if (command.kind == DRAW_SPRITE) {
+
+            drawSprite(&sprites[command.key & 0xFFF], command.x, command.y);
+
+        } else if (command.kind == DRAW_RECTANGLE) {
+
+            fillRectangle(command.x, command.y, command.x1, command.y1, command.color);
+
+        } else {
+
+            drawLine(command.x, command.y, command.x1, command.y1, command.color);
+
+        }
+
+    }
+
+
+    list.count = 0;
+
+}
+
+
+/*
+
+*   components. an entity is just a row number, and each kind of entity (an archetype) keeps one array per component
+
+*   it has, so a system only walks the arrays it actually uses.
+
+*   the small fields are laid out so there is never any padding, and the archetypes can go straight into snapshots
+
+*/
+
+struct Transform {
+
+    Real x, y, angle;
+
+    unsigned char width, height;
+
+    unsigned char mirrored; // drawn flipped left to right, so it faces left
+
+    unsigned char unused; // keeps Transform at 16 bytes
+
+};
+
+// the step taken this tick (speed is how long that step is allowed to be)
+
+struct Velocity {
+
+    Real x, y, speed;
+
+};
+
+// where and when an attack was fired, its position is worked out from this instead of stepped every tick
+
+struct Path {
+
+    Real originX, originY;
+
+    unsigned int spawnTick, expireTick;
+
+};
+
+struct Health {
+
+    int health;
+
+};
+
+struct Damage {
+
+    short amount;
+
+    unsigned char kind; // enemy type for enemies, item for attacks
+
+    unsigned char lastHitBy; // item that last hurt an enemy, for telemetry
+
+};
+
+// invincibility ticks after an enemy gets hit
+
+struct Cooldown {
+
+    signed char ticks;
+
+    unsigned char active;
+
+};
+
+struct SpriteId {
+
+    unsigned short sprite; // index into ENTITY_SPRITES, see entitySprite
+
+};
+
+// plays the frameCount sprites starting at sheet, frameTicks ticks each
+
+struct Animation {
+
+    unsigned short sheet;
+
+    unsigned char frameCount;
+
+    unsigned char frameTicks;
+
+    unsigned char frame;
+
+    unsigned char ticks;
+
+};
+
+
+// the player's animations, walking flips between the walk and standing sprites every 15 ticks (250 ms at 60 fps)
+
+const Animation PLAYER_WALK_ANIMATION = {SPRITE_PLAYER_WALK, 2, 15, 0, 0};
+
+const Animation PLAYER_IDLE_ANIMATION = {SPRITE_PLAYER, 1, 15, 0, 0};
+
+// enemies only have one frame for now, more go right after each EnemyNFEH.pic in ENTITY_SPRITES
+
+const int ENEMY_WALK_FRAMES = 1;
+
+const int ENEMY_WALK_FRAME_TICKS = 15;
+
+
+// BENCHMARK ramps the counts far past what the game allows, to find where the frame budget runs out
+
+#ifdef BENCHMARK
+
+const int MAX_ENEMIES = 4096;
+
+const int MAX_ATTACKS = 4096;
+
+#else
+
+const int MAX_ENEMIES = 50;
+
+const int MAX_ATTACKS = 50;
+
+#endif
+
+const int ENEMY_HIT_COOLDOWN = 30;
+
+
+// what one enemy or attack costs across all of its component arrays. each array is walked on its own, so a row
+
+// never has to fit in a cache line, but every byte of it goes through the cache for every enemy each tick and is
+
+// copied into every snapshot. so they have a budget, which keeps all the rows of a full game (MAX_ENEMIES enemies
+
+// and MAX_ATTACKS attacks) at about 5 KB, well inside the L1 cache with room for the frame being drawn
+
+const int ENEMY_ROW_BYTES = sizeof(Transform) + sizeof(Velocity) + sizeof(Health) + sizeof(Damage) +
+
+    sizeof(Cooldown) + sizeof(SpriteId) + sizeof(Animation);
+
+const int ATTACK_ROW_BYTES = sizeof(Transform) + sizeof(Velocity) + sizeof(Path) + sizeof(Health) +
+
+    sizeof(Damage) + sizeof(SpriteId);
+
+static_assert(ENEMY_ROW_BYTES < 48, "an enemy row is over its 48 byte budget");
+
+static_assert(ATTACK_ROW_BYTES < 56, "an attack row is over its 56 byte budget");
+
+
+/*
+
+*   the archetypes. rows past count are always kept zeroed, so snapshots of them compress well
+
+*/
+
+struct PlayerArchetype {
+
+    Transform transform;
+
+    Velocity velocity;
+
+    Health health;
+
+    SpriteId sprite;
+
+    Animation animation;
+
+    int xp, level;
+
+};
+
+struct EnemyArchetype {
+
+    int count;
+
+    Transform transform[MAX_ENEMIES];
+
+    Velocity velocity[MAX_ENEMIES];
+
+    Health health[MAX_ENEMIES];
+
+    Damage damage[MAX_ENEMIES];
+
+    Cooldown cooldown[MAX_ENEMIES];
+
+    SpriteId sprite[MAX_ENEMIES];
+
+    Animation animation[MAX_ENEMIES];
+
+};
+
+// kept sorted by the tick each attack goes off screen, so the expired ones are always at the front
+
+struct AttackArchetype {
+
+    int count;
+
+    Transform transform[MAX_ATTACKS];
+
+    Velocity velocity[MAX_ATTACKS];
+
+    Path path[MAX_ATTACKS];
+
+    Health health[MAX_ATTACKS];
+
+    Damage damage[MAX_ATTACKS];
+
+    SpriteId sprite[MAX_ATTACKS];
+
+};
+
+
+// true if the two boxes overlap
+
+bool isColliding(const Transform& a, const Transform& b) {
+
+    return a.x < b.x + b.width && a.x + a.width > b.x && a.y < b.y + b.height && a.y + a.height > b.y;
+
+}
+
+
+// true if the point is inside the box
+
+bool isCollidingWithPoint(const Transform& a, Real pointX, Real pointY) {
+
+    return a.x < pointX && a.x + a.width > pointX && a.y < pointY && a.y + a.height > pointY;
+
+}
+
+
+// unit vectors for the marble ring, 45 degree increments starting at 45 degrees
+
+const float MARBLE_DIRECTIONS[8][2] = {
+
+    {0.70710678, 0.70710678}, {0, 1}, {-0.70710678, 0.70710678}, {-1, 0},
+
+    {-0.70710678, -0.70710678}, {0, -1}, {0.70710678, -0.70710678}, {1, 0}
+
+};
+
+
+// marks an attack that never leaves the screen on its own (like the circuit, which doesn't move)
+
+const unsigned long NEVER_EXPIRES = 0xFFFFFFFFul; // fits in 32 bits so snapshots can store it
+
+
+/*
+
+*   returns how many ticks it takes something moving at velocity to leave [0, limit] starting from position
+
+*/
+
+unsigned long ticksUntilOut(Real position, Real velocity, Real limit) {
+
+    // basically not moving on this axis
+
+    if (velocity < Real(0.0001) && velocity > Real(-0.0001)) {
+
+        if (position < 0 || position > limit) return 0;
+
+        return NEVER_EXPIRES;
+
+    }
+
+
+#ifdef FIXED_POINT_PHYSICS
+
+    // distance over speed as a Fixed is more than Q16.16 holds for anything slower than about 0.01 a tick,
+
+    // but the raw values divide straight into the whole number of ticks
+
+    long long distance = velocity > 0 ? (long long)limit.raw - position.raw : position.raw;
+
+    long long speed = velocity > 0 ? velocity.raw : -(long long)velocity.raw;
+
+    if (distance < 0) return 0;
+
+    return (unsigned long)(distance / speed) + 1;
+
+#else
+
+    Real ticks;
+
+
+    // first whole tick where the position is past the edge it is moving towards
+
+    if (velocity > 0) {
+
+        ticks = (limit - position) / velocity;
+
+    } else {
+
+        ticks = position / -velocity;
+
+    }
+
+
+    if (ticks < 0) return 0;
+
+    return (unsigned long)(int)ticks + 1;
+
+#endif
+
+}
+
+
+// template type T used so removeFromArray works on any component array
+
+template <class T>
+
+void removeFromArray(T[], int, int);
+
+
+/*
+
+*   adds an enemy row. returns false (and adds nothing) if there are already MAX_ENEMIES
+
+*/
+
+bool addEnemy(EnemyArchetype& enemies, Real x, Real y, int width, int height, int health, Real speed, int damage, int type, int sprite) {
+
+    if (enemies.count >= MAX_ENEMIES) return false;
+
+
+    int i = enemies.count++;
+
+    enemies.transform[i] = {x, y, 0, (unsigned char)width, (unsigned char)height, 0, 0};
+
+    enemies.velocity[i] = {0, 0, speed};
+
+    enemies.health[i] = {health};
+
+    enemies.damage[i] = {(short)damage, (unsigned char)type, ITEM_COUNT};
+
+    enemies.cooldown[i] = {ENEMY_HIT_COOLDOWN, false};
+
+    enemies.sprite[i] = {(unsigned short)sprite};
+
+    // start each enemy at a different point in its walk so they don't all step together
+
+    enemies.animation[i] = {(unsigned short)sprite, ENEMY_WALK_FRAMES, ENEMY_WALK_FRAME_TICKS, (unsigned char)(i % ENEMY_WALK_FRAMES), 0};
+
+    return true;
+
+}
+
+
+// removes an enemy row, keeping the others in order
+
+void removeEnemy(EnemyArchetype& enemies, int row) {
+
+    removeFromArray(enemies.transform, enemies.count, row);
+
+    removeFromArray(enemies.velocity, enemies.count, row);
+
+    removeFromArray(enemies.health, enemies.count, row);
+
+    removeFromArray(enemies.damage, enemies.count, row);
+
+    removeFromArray(enemies.cooldown, enemies.count, row);
+
+    removeFromArray(enemies.sprite, enemies.count, row);
+
+    removeFromArray(enemies.animation, enemies.count, row);
+
+    enemies.count--;
+
+
+    // keep the unused rows zero
+
+    int last = enemies.count;
+
+    enemies.transform[last] = Transform();
+
+    enemies.velocity[last] = Velocity();
+
+    enemies.health[last] = Health();
+
+    enemies.damage[last] = Damage();
+
+    enemies.cooldown[last] = Cooldown();
+
+    enemies.sprite[last] = SpriteId();
+
+    enemies.animation[last] = Animation();
+
+}
+
+
+// one attack to fire, with everything addAttacks needs to know about it
+
+struct AttackSpawn {
+
+    Real x, y;
+
+    int width, height, health;
+
+    Real velocityX, velocityY;
+
+    int damage, weapon, sprite;
+
+};
+
+
+// the most attacks fired in one batch (the marble ring)
+
+const int MAX_ATTACK_BATCH = 8;
+
+
+// the tick an attack fired at tick goes off screen, whichever axis leaves first
+
+unsigned long attackExpireTick(const AttackSpawn& spawn, unsigned long tick) {
+
+    unsigned long xTicks = ticksUntilOut(spawn.x, spawn.velocityX, WINDOW_WIDTH - spawn.width);
+
+    unsigned long yTicks = ticksUntilOut(spawn.y, spawn.velocityY, WINDOW_HEIGHT - spawn.height);
+
+    unsigned long ticks = xTicks < yTicks ? xTicks : yTicks;
+
+    return ticks == NEVER_EXPIRES ? NEVER_EXPIRES : tick + ticks;
+
+}
+
+
+/*
+
+*   fires a batch of up to MAX_ATTACK_BATCH attacks at tick, like the whole marble ring at once. the batch is sorted by
+
+*   the tick each goes off screen and merged into the attacks from the back, so every row moves at most once
+
+*   (new attacks almost always last the longest, so that's usually no moves at all). attacks that go off screen on the
+
+*   same tick stay in the order they were fired. returns false if there wasn't room for all of them, then only the first
+
+*   ones in the batch are fired
+
+*/
+
+bool addAttacks(AttackArchetype& attacks, const AttackSpawn batch[], int count, unsigned long tick) {
+
+    if (count > MAX_ATTACK_BATCH) count = MAX_ATTACK_BATCH;
+
+    bool fits = count <= MAX_ATTACKS - attacks.count;
+
+    if (!fits) count = MAX_ATTACKS - attacks.count;
+
+
+    // sort the batch by expire tick (insertion sort, there are at most 8)
+
+    int order[MAX_ATTACK_BATCH];
+
+    unsigned long expireTicks[MAX_ATTACK_BATCH];
+
+    for (int i = 0; i < count; i++) {
+
+        unsigned long expireTick = attackExpireTick(batch[i], tick);
+
+        int j = i;
+
+        while (j > 0 && expireTicks[j - 1] > expireTick) {
+
+            order[j] = order[j - 1];
+
+            expireTicks[j] = expireTicks[j - 1];
+
+            j--;
+
+        }
+
+        order[j] = i;
+
+        expireTicks[j] = expireTick;
+
+    }
+
+
+    // merge from the back so nothing gets overwritten before it is moved
+
+    int from = attacks.count - 1;
+
+    int next = count - 1;
+
+    for (int to = attacks.count + count - 1; next >= 0; to--) {
+
+        if (from >= 0 && attacks.path[from].expireTick > expireTicks[next]) {
+
+            attacks.transform[to] = attacks.transform[from];
+
+            attacks.velocity[to] = attacks.velocity[from];
+
+            attacks.path[to] = attacks.path[from];
+
+            attacks.health[to] = attacks.health[from];
+
+            attacks.damage[to] = attacks.damage[from];
+
+            attacks.sprite[to] = attacks.sprite[from];
+
+            from--;
+
+        } else {
+
+            const AttackSpawn& spawn = batch[order[next]];
+
+            attacks.transform[to] = {spawn.x, spawn.y, 0, (unsigned char)spawn.width, (unsigned char)spawn.height, 0, 0};
+
+            attacks.velocity[to] = {spawn.velocityX, spawn.velocityY, realLength(spawn.velocityX, spawn.velocityY)};
+
+            attacks.path[to] = {spawn.x, spawn.y, (unsigned int)tick, (unsigned int)expireTicks[next]};
+
+            attacks.health[to] = {spawn.health};
+
+            attacks.damage[to] = {(short)spawn.damage, (unsigned char)spawn.weapon, ITEM_COUNT};
+
+            attacks.sprite[to] = {(unsigned short)spawn.sprite};
+
+            next--;
+
+        }
+
+    }
+
+
+    attacks.count += count;
+
+    return fits;
+
+}
+
+
+// fires one attack from (x, y), returns false if there are already MAX_ATTACKS
+
+bool addAttack(AttackArchetype& attacks, Real x, Real y, int width, int height, int health, Real velocityX, Real velocityY, int damage, int weapon, unsigned long tick, int sprite) {
+
+    AttackSpawn spawn = {x, y, width, height, health, velocityX, velocityY, damage, weapon, sprite};
+
+    return addAttacks(attacks, &spawn, 1, tick);
+
+}
+
+
+/*
+
+*   removes the rows [first, first + rows) from the attacks, keeping the rest in order
+
+*/
+
+void removeAttacks(AttackArchetype& attacks, int first, int rows) {
+
+    for (int i = first + rows; i < attacks.count; i++) {
+
+        attacks.transform[i - rows] = attacks.transform[i];
+
+        attacks.velocity[i - rows] = attacks.velocity[i];
+
+        attacks.path[i - rows] = attacks.path[i];
+
+        attacks.health[i - rows] = attacks.health[i];
+
+        attacks.damage[i - rows] = attacks.damage[i];
+
+        attacks.sprite[i - rows] = attacks.sprite[i];
+
+    }
+
+    attacks.count -= rows;
+
+
+    // keep the unused rows zero
+
+    for (int i = attacks.count; i < attacks.count + rows; i++) {
+
+        attacks.transform[i] = Transform();
+
+        attacks.velocity[i] = Velocity();
+
+        attacks.path[i] = Path();
+
+        attacks.health[i] = Health();
+
+        attacks.damage[i] = Damage();
+
+        attacks.sprite[i] = SpriteId();
+
+    }
+
+}
+
+
+// sizes of the particle pools, these are fixed so effects never allocate while playing
+
+const int MAX_PARTICLES = 32768;
+
+const int MAX_DAMAGE_NUMBERS = 64;
+
+
+/*
+
+*   pool of particles for hit sparks, death bursts and level up effects, plus floating damage numbers.
+
+*   each field is its own array so the update loop only touches plain floats and the compiler can vectorize it.
+
+*   dead particles are removed by swapping the last one into their spot
+
+*/
+
+struct Particles {
+
+    int count = 0;
+
+    float x[MAX_PARTICLES], y[MAX_PARTICLES];
+
+    float velocityX[MAX_PARTICLES], velocityY[MAX_PARTICLES];
+
+    int life[MAX_PARTICLES];
+
+    Pixel color[MAX_PARTICLES];
+
+
+    int numberCount = 0;
+
+    float numberX[MAX_DAMAGE_NUMBERS], numberY[MAX_DAMAGE_NUMBERS];
+
+    int numberValue[MAX_DAMAGE_NUMBERS];
+
+    int numberLife[MAX_DAMAGE_NUMBERS];
+
+
+    // separate random state so effects don't change what the game rolls
+
+    unsigned int seed = 2463534242u;
+
+};
+
+
+/*
+
+*   cheap xorshift random number between 0 and 1 for particle directions
+
+*/
+
+float particleRandom(Particles& particles) {
+
+    particles.seed ^= particles.seed << 13;
+
+    particles.seed ^= particles.seed >> 17;
+
+    particles.seed ^= particles.seed << 5;
+
+    return (particles.seed & 0xFFFF) / 65536.0;
+
+}
+
+
+/*
+
+*   spawns a burst of particles going out from a point in random directions.
+
+*   if the pool is full, the rest of the burst is dropped
+
+*/
+
+void emitParticles(Particles& particles, float x, float y, int amount, float maxSpeed, int life, unsigned int color) {
+
+    if (amount > MAX_PARTICLES - particles.count) amount = MAX_PARTICLES - particles.count;
+
+    Pixel pixel = toPixel(color);
+
+
+    for (int i = 0; i < amount; i++) {
+
+        int p = particles.count++;
+
+
+        // random direction and speed, both taken from the 8 unit vectors so no trig is needed
+
+        int direction = particleRandom(particles) * 8;
+
+        float speed = maxSpeed * (0.25 + 0.75*particleRandom(particles));
+
+
+        particles.x[p] = x;
+
+        particles.y[p] = y;
+
+        particles.velocityX[p] = MARBLE_DIRECTIONS[direction][0] * speed + (particleRandom(particles) - 0.5) * maxSpeed;
+
+        particles.velocityY[p] = MARBLE_DIRECTIONS[direction][1] * speed + (particleRandom(particles) - 0.5) * maxSpeed;
+
+        particles.life[p] = life / 2 + particleRandom(particles) * life / 2;
+
+        particles.color[p] = pixel;
+
+    }
+
+}
+
+
+// adds a floating damage number, dropped if there are already too many on screen
+
+void emitDamageNumber(Particles& particles, float x, float y, int value) {
+
+    if (particles.numberCount >= MAX_DAMAGE_NUMBERS) return;
+
+
+    int n = particles.numberCount++;
+
+    particles.numberX[n] = x;
+
+    particles.numberY[n] = y;
+
+    particles.numberValue[n] = value;
+
+    particles.numberLife[n] = 30;
+
+}
+
+
+/*
+
+*   moves every particle one tick and removes the ones that ran out of life
+
+*/
+
+void updateParticles(Particles& particles) {
+
+    int count = particles.count;
+
+
+    // integrate, these loops are straight through the arrays so they vectorize
+
+    for (int i = 0; i < count; i++) {
+
+        particles.x[i] += particles.velocityX[i];
+
+        particles.y[i] += particles.velocityY[i];
+
+    }
+
+    for (int i = 0; i < count; i++) {
+
+        // a bit of drag and gravity so bursts slow down and fall
+
+        particles.velocityX[i] *= 0.94;
+
+        particles.velocityY[i] = particles.velocityY[i] * 0.94 + 0.05;
+
+        particles.life[i]--;
+
+    }
+
+
+    // swap remove dead particles
+
+    for (int i = 0; i < count; i++) {
+
+        while (i < count && particles.life[i] <= 0) {
+
+            count--;
+
+            particles.x[i] = particles.x[count];
+
+            particles.y[i] = particles.y[count];
+
+            particles.velocityX[i] = particles.velocityX[count];
+
+            particles.velocityY[i] = particles.velocityY[count];
+
+            particles.life[i] = particles.life[count];
+
+            particles.color[i] = particles.color[count];
+
+        }
+
+    }
+
+    particles.count = count;
+
+
+    // damage numbers just float upwards
+
+    for (int i = 0; i < particles.numberCount; i++) {
+
+        particles.numberY[i] -= 0.5;
+
+        particles.numberLife[i]--;
+
+
+        if (particles.numberLife[i] <= 0) {
+
+            int last = --particles.numberCount;
+
+            particles.numberX[i] = particles.numberX[last];
+
+            particles.numberY[i] = particles.numberY[last];
+
+            particles.numberValue[i] = particles.numberValue[last];
+
+            particles.numberLife[i] = particles.numberLife[last];
+
+            i--;
+
+        }
+
+    }
+
+}
+
+
+// draws all the particles into the frame in one pass
+
+void drawParticles(Particles& particles) {
+
+    for (int i = 0; i < particles.count; i++) {
+
+        drawPixel(particles.x[i], particles.y[i], particles.color[i]);
+
+    }
+
+}
+
+
+/*
+
+*   writes the damage numbers straight to the LCD (after the frame is presented, the frame has no font)
+
+*   and marks where they were so the next frame paints over them
+
+*/
+
+void drawDamageNumbers(Particles& particles) {
+
+    if (particles.numberCount == 0) return;
+
+
+    LCD.SetFontColor(WHITE);
+
+    for (int i = 0; i < particles.numberCount; i++) {
+
+        LCD.WriteAt(particles.numberValue[i], particles.numberX[i], particles.numberY[i]);
+
+        invalidateRectangle(particles.numberX[i], particles.numberY[i], 2*CHAR_WIDTH, CHAR_HEIGHT);
+
+    }
+
+}
+
+
+/*
+
+*   the game's own random number generator. FEHRandom doesn't let us read or set its state,
+
+*   so the game uses this instead to be able to save it in snapshots and get the same rolls back
+
+*/
+
+struct GameRandom {
+
+    unsigned int state = 1;
+
+
+    void seed(unsigned int set) {
+
+        state = set;
+
+    }
+
+
+    // random int between 0 and 32767, same range as RandInt
+
+    int randInt() {
+
+        state = state * 1103515245u + 12345u;
+
+        return (state >> 16) & 0x7FFF;
+
+    }
+
+};
+
+
+GameRandom gameRandom;
+
+
+#ifdef TELEMETRY
+
+
+// how many events fit in the ring, has to be a power of two
+
+const int TELEMETRY_CAPACITY = 4096;
+
+
+/*
+
+*   single producer / single consumer ring of telemetry events. the game is the only one that moves head
+
+*   and the writer thread is the only one that moves tail, so neither side ever has to wait for the other.
+
+*   if the writer falls behind and the ring fills up, new events are dropped (and counted) instead of blocking.
+
+*   the count goes in the file as the last event of the run
+
+*/
+
+struct Telemetry {
+
+    TelemetryEvent events[TELEMETRY_CAPACITY];
+
+    std::atomic<unsigned int> head;
+
+    std::atomic<unsigned int> tail;
+
+    std::atomic<bool> running;
+
+    unsigned int dropped;
+
+
+    // damage taken from each enemy type since hurtTick, logged as one PLAYER_HURT per type every ENEMY_HIT_COOLDOWN
+
+    // ticks instead of one for every enemy touching the player on every tick
+
+    int hurt[2 * ENEMY_BOSS_TYPE];
+
+    unsigned int hurtTick;
+
+
+    // stamped onto every event, updated once per tick so logging doesn't have to read the clock
+
+    unsigned long startTime;
+
+    unsigned int time;
+
+    unsigned int tick;
+
+
+    FILE* file;
+
+    std::thread writer;
+
+};
+
+
+Telemetry telemetry;
+
+
+/*
+
+*   runs on the writer thread, copies whatever the game has logged to the file every 20 ms
+
+*/
+
+void telemetryWriter() {
+
+    while (true) {
+
+        bool stopping = !telemetry.running.load(std::memory_order_acquire);
+
+
+        unsigned int head = telemetry.head.load(std::memory_order_acquire);
+
+        unsigned int tail = telemetry.tail.load(std::memory_order_relaxed);
+
+        while (tail != head) {
+
+            // write up to the end of the array in one go, then wrap around
+
+            unsigned int start = tail % TELEMETRY_CAPACITY;
+
+            unsigned int amount = head - tail;
+
+            if (amount > TELEMETRY_CAPACITY - start) amount = TELEMETRY_CAPACITY - start;
+
+
+            fwrite(&telemetry.events[start], sizeof(TelemetryEvent), amount, telemetry.file);
+
+            tail += amount;
+
+            telemetry.tail.store(tail, std::memory_order_release);
+
+        }
+
+        fflush(telemetry.file);
+
+
+        if (stopping) break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    }
+
+}
+
+
+/*
+
+*   opens the telemetry file (adding on to the end so every run is kept) and starts the writer thread
+
+*/
+
+void startTelemetry(const char fileName[]) {
+
+    telemetry.file = fopen(fileName, "ab");
+
+    if (telemetry.file == NULL) return;
+
+
+    // new file, so write the header first
+
+    fseek(telemetry.file, 0, SEEK_END);
+
+    if (ftell(telemetry.file) == 0) {
+
+        int eventSize = sizeof(TelemetryEvent);
+
+        fwrite(TELEMETRY_MAGIC, 4, 1, telemetry.file);
+
+        fwrite(&TELEMETRY_VERSION, sizeof(int), 1, telemetry.file);
+
+        fwrite(&eventSize, sizeof(int), 1, telemetry.file);
+
+    }
+
+
+    telemetry.head.store(0);
+
+    telemetry.tail.store(0);
+
+    telemetry.dropped = 0;
+
+    memset(telemetry.hurt, 0, sizeof(telemetry.hurt));
+
+    telemetry.hurtTick = 0;
+
+    telemetry.startTime = TimeNowMSec();
+
+    telemetry.time = 0;
+
+    telemetry.tick = 0;
+
+    telemetry.running.store(true);
+
+    telemetry.writer = std::thread(telemetryWriter);
+
+}
+
+
+// lets the writer empty the ring, then adds how many events were dropped and closes the file
+
+void stopTelemetry() {
+
+    if (telemetry.file == NULL) return;
+
+
+    telemetry.running.store(false, std::memory_order_release);
+
+    telemetry.writer.join();
+
+
+    // written straight to the file now that the writer is done, so it can't be dropped itself
+
+    TelemetryEvent trailer = {telemetry.time, telemetry.tick, TELEMETRY_EVENTS_DROPPED, 0, (int)telemetry.dropped};
+
+    fwrite(&trailer, sizeof(TelemetryEvent), 1, telemetry.file);
+
+    fclose(telemetry.file);
+
+    telemetry.file = NULL;
+
+}
+
+
+// called once per tick so events get the time without each one reading the clock
+
+void setTelemetryTick(unsigned long tick) {
+
+    telemetry.tick = tick;
+
+    telemetry.time = TimeNowMSec() - telemetry.startTime;
+
+}
+
+
+/*
+
+*   adds an event to the ring, this is the only part the game loop pays for
+
+*/
+
+inline void logTelemetry(int type, int subject, int value) {
+
+    if (telemetry.file == NULL) return;
+
+
+    unsigned int head = telemetry.head.load(std::memory_order_relaxed);
+
+    if (head - telemetry.tail.load(std::memory_order_acquire) >= TELEMETRY_CAPACITY) {
+
+        telemetry.dropped++;
+
+        return;
+
+    }
+
+
+    TelemetryEvent& event = telemetry.events[head % TELEMETRY_CAPACITY];
+
+    event.time = telemetry.time;
+
+    event.tick = telemetry.tick;
+
+    event.type = type;
+
+    event.subject = subject;
+
+    event.value = value;
+
+
+    telemetry.head.store(head + 1, std::memory_order_release);
+
+}
+
+
+// logs the damage each enemy type has done since the last time and starts counting again
+
+void flushPlayerHurt() {
+
+    for (int i = 0; i < 2 * ENEMY_BOSS_TYPE; i++) {
+
+        if (telemetry.hurt[i] > 0) logTelemetry(TELEMETRY_PLAYER_HURT, i, telemetry.hurt[i]);
+
+        telemetry.hurt[i] = 0;
+
+    }
+
+    telemetry.hurtTick = telemetry.tick;
+
+}
+
+
+// adds to the damage taken from an enemy type, it goes out as an event once the cooldown has passed
+
+inline void logPlayerHurt(int kind, int amount) {
+
+    if (telemetry.file == NULL) return;
+
+
+    telemetry.hurt[kind] += amount;
+
+    if (telemetry.tick - telemetry.hurtTick >= ENEMY_HIT_COOLDOWN) flushPlayerHurt();
+
+}
+
+
+#else
+
+
+// telemetry turned off, these compile away to nothing
+
+inline void startTelemetry(const char[]) {}
+
+inline void stopTelemetry() {}
+
+inline void setTelemetryTick(unsigned long) {}
+
+inline void logTelemetry(int, int, int) {}
+
+inline void flushPlayerHurt() {}
+
+inline void logPlayerHurt(int, int) {}
+
+
+#endif
+
+
+#ifdef CAPTURE
+
+
+// how many frames can wait for the encoder before new ones get dropped
+
+const int CAPTURE_SLOTS = 4;
+
+// worst case for one encoded frame is every pixel being its own run
+
+const int CAPTURE_BUFFER_SIZE = WINDOW_WIDTH * WINDOW_HEIGHT * CAPTURE_RUN_SIZE;
+
+
+/*
+
+*   frame capture. the game only copies each presented frame into a free slot, the encoder thread does
+
+*   the XOR against the previous frame, the run length encoding and the file writing.
+
+*   slots are handed over the same way as the telemetry ring (game moves head, encoder moves tail)
+
+*/
+
+struct Capture {
+
+    unsigned int frames[CAPTURE_SLOTS][WINDOW_HEIGHT][WINDOW_WIDTH];
+
+    unsigned int frameTime[CAPTURE_SLOTS];
+
+    std::atomic<unsigned int> head;
+
+    std::atomic<unsigned int> tail;
+
+    std::atomic<bool> running;
+
+    unsigned int dropped;
+
+    unsigned long startTime;
+
+
+    // only the encoder thread touches these
+
+    unsigned int previous[WINDOW_HEIGHT][WINDOW_WIDTH];
+
+    unsigned char buffer[CAPTURE_BUFFER_SIZE];
+
+    unsigned int frameNumber;
+
+
+    FILE* file;
+
+    std::thread encoder;
+
+};
+
+
+Capture capture;
+
+
+/*
+
+*   encodes one frame as rows of (run length, XOR against the previous frame) pairs and writes it out
+
+*/
+
+void encodeCaptureFrame(int slot) {
+
+    int size = 0;
+
+
+    for (int row = 0; row < WINDOW_HEIGHT; row++) {
+
+        const unsigned int* pixels = capture.frames[slot][row];
+
+        unsigned int* previous = capture.previous[row];
+
+
+        int col = 0;
+
+        while (col < WINDOW_WIDTH) {
+
+            unsigned int value = pixels[col] ^ previous[col];
+
+            unsigned short length = 0;
+
+            while (col < WINDOW_WIDTH && (pixels[col] ^ previous[col]) == value) {
+
+                previous[col] = pixels[col];
+
+                length++;
+
+                col++;
+
+            }
+
+
+            memcpy(&capture.buffer[size], &length, 2);
+
+            memcpy(&capture.buffer[size + 2], &value, 4);
+
+            size += CAPTURE_RUN_SIZE;
+
+        }
+
+    }
+
+
+    CaptureFrameHeader header;
+
+    header.frame = capture.frameNumber++;
+
+    header.time = capture.frameTime[slot];
+
+    header.size = size;
+
+    fwrite(&header, sizeof(CaptureFrameHeader), 1, capture.file);
+
+    fwrite(capture.buffer, 1, size, capture.file);
+
+}
+
+
+// runs on the encoder thread, encodes frames as they come in until capture is stopped
+
+void captureEncoder() {
+
+    while (true) {
+
+        bool stopping = !capture.running.load(std::memory_order_acquire);
+
+
+        unsigned int head = capture.head.load(std::memory_order_acquire);
+
+        unsigned int tail = capture.tail.load(std::memory_order_relaxed);
+
+        while (tail != head) {
+
+            encodeCaptureFrame(tail % CAPTURE_SLOTS);
+
+            tail++;
+
+            capture.tail.store(tail, std::memory_order_release);
+
+        }
+
+
+        if (stopping) break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    }
+
+}
+
+
+// opens the capture file, writes its header and starts the encoder thread
+
+void startCapture(const char fileName[]) {
+
+    capture.file = fopen(fileName, "wb");
+
+    if (capture.file == NULL) return;
+
+
+    int header[3] = {CAPTURE_VERSION, WINDOW_WIDTH, WINDOW_HEIGHT};
+
+    fwrite(CAPTURE_MAGIC, 4, 1, capture.file);
+
+    fwrite(header, sizeof(int), 3, capture.file);
+
+
+    memset(capture.previous, 0, sizeof(capture.previous));
+
+    capture.frameNumber = 0;
+
+    capture.dropped = 0;
+
+    capture.startTime = TimeNowMSec();
+
+    capture.head.store(0);
+
+    capture.tail.store(0);
+
+    capture.running.store(true);
+
+    capture.encoder = std::thread(captureEncoder);
+
+}
+
+
+// lets the encoder finish the frames it has, then ends the file with how many frames it has and how many were dropped
+
+void stopCapture() {
+
+    if (capture.file == NULL) return;
+
+
+    capture.running.store(false, std::memory_order_release);
+
+    capture.encoder.join();
+
+
+    CaptureTrailer trailer = {CAPTURE_END, capture.frameNumber, capture.dropped};
+
+    fwrite(&trailer, sizeof(CaptureTrailer), 1, capture.file);
+
+    fclose(capture.file);
+
+    capture.file = NULL;
+
+}
+
+
+// hands the frame that was just presented to the encoder, or drops it if the encoder is behind
+
+void captureFrame() {
+
+    if (capture.file == NULL) return;
+
+
+    unsigned int head = capture.head.load(std::memory_order_relaxed);
+
+    if (head - capture.tail.load(std::memory_order_acquire) >= CAPTURE_SLOTS) {
+
+        capture.dropped++;
+
+        return;
+
+    }
+
+
+    int slot = head % CAPTURE_SLOTS;
+
+#ifdef INDEXED_COLOR
+
+    // the capture file has full colors
+
+    for (int row = 0; row < WINDOW_HEIGHT; row++) {
+
+        for (int col = 0; col < WINDOW_WIDTH; col++) {
+
+            capture.frames[slot][row][col] = pixelColor(screen.pixels[row][col]);
+
+        }
+
+    }
+
+#else
+
+    memcpy(capture.frames[slot], screen.pixels, sizeof(screen.pixels));
+
+#endif
+
+    capture.frameTime[slot] = TimeNowMSec() - capture.startTime;
+
+
+    capture.head.store(head + 1, std::memory_order_release);
+
+}
+
+
+#else
+
+
+// capture turned off, these compile away to nothing
+
+inline void startCapture(const char[]) {}
+
+inline void stopCapture() {}
+
+inline void captureFrame() {}
+
+
+#endif
+
+
+/*
+
+*   one poll of the touch screen, stamped with when it was read and which tick used it
+
+*/
+
+struct InputSample {
+
+    bool touching;
+
+    float x, y;
+
+    unsigned long time;
+
+    unsigned long tick;
+
+};
+
+
+// latency histograms have 1 ms buckets, the last bucket catches everything slower
+
+const int LATENCY_BUCKETS = 256;
+
+
+struct LatencyHistogram {
+
+    unsigned int count[LATENCY_BUCKETS];
+
+    unsigned int total;
+
+};
+
+
+/*
+
+*   how long input takes to show up. touchToPresent is from reading the touch to the end of presenting
+
+*   the first frame where the player moved because of it, frameTime is from one present to the next
+
+*/
+
+struct LatencyStats {
+
+    LatencyHistogram touchToPresent;
+
+    LatencyHistogram frameTime;
+
+    unsigned long lastPresent;
+
+    // running average of touchToPresent, used to guess when this frame will be on screen
+
+    float averageTouchToPresent;
+
+};
+
+
+void clearLatencyStats(LatencyStats& stats) {
+
+    memset(&stats, 0, sizeof(LatencyStats));
+
+    stats.lastPresent = TimeNowMSec();
+
+}
+
+
+void addLatency(LatencyHistogram& histogram, unsigned long ms) {
+
+    if (ms >= LATENCY_BUCKETS) ms = LATENCY_BUCKETS - 1;
+
+    histogram.count[ms]++;
+
+    histogram.total++;
+
+}
+
+
+// the smallest latency that percent of the samples are at or under, in ms
+
+int latencyPercentile(const LatencyHistogram& histogram, int percent) {
+
+    if (histogram.total == 0) return 0;
+
+
+    unsigned long needed = ((unsigned long)histogram.total * percent + 99) / 100;
+
+    unsigned long seen = 0;
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+
+        seen += histogram.count[i];
+
+        if (seen >= needed) return i;
+
+    }
+
+    return LATENCY_BUCKETS - 1;
+
+}
+
+
+/*
+
+*   called right after a frame is presented. if the input read this tick moved the player,
+
+*   this frame is the first one showing it
+
+*/
+
+void recordPresent(LatencyStats& stats, const InputSample& input, unsigned long tick, bool inputMovedPlayer) {
+
+    unsigned long now = TimeNowMSec();
+
+
+    if (input.touching && input.tick == tick && inputMovedPlayer) {
+
+        addLatency(stats.touchToPresent, now - input.time);
+
+        stats.averageTouchToPresent += 0.1 * ((float)(now - input.time) - stats.averageTouchToPresent);
+
+    }
+
+    addLatency(stats.frameTime, now - stats.lastPresent);
+
+    stats.lastPresent = now;
+
+}
+
+
+// how many touch samples the predictor looks back over, and how far back they can be
+
+const int TOUCH_HISTORY = 8;
+
+const unsigned long TOUCH_HISTORY_MS = 120;
+
+// limits on how far ahead the predictor guesses, so a bad guess can't fling the player
+
+const float MAX_PREDICTION_MS = 100;
+
+const float MAX_PREDICTION_DISTANCE = 48;
+
+// slower than this (pixels per ms) counts as the finger holding still, so small wobbles don't move the target
+
+const float TOUCH_JITTER_SPEED = 0.02;
+
+
+/*
+
+*   keeps the last few touch samples so the target can be moved ahead to where the finger will be
+
+*   when the frame actually shows up, instead of where it was when we read it
+
+*/
+
+struct TouchPredictor {
+
+    InputSample samples[TOUCH_HISTORY];
+
+    int count;
+
+    int newest;
+
+};
+
+
+void clearTouchPredictor(TouchPredictor& predictor) {
+
+    predictor.count = 0;
+
+    predictor.newest = -1;
+
+}
+
+
+// adds the sample read this tick, letting go of the screen forgets the old path
+
+void addTouchSample(TouchPredictor& predictor, const InputSample& input) {
+
+    if (!input.touching) {
+
+        clearTouchPredictor(predictor);
+
+        return;
+
+    }
+
+
+    predictor.newest = (predictor.newest + 1) % TOUCH_HISTORY;
+
+    predictor.samples[predictor.newest] = input;
+
+    if (predictor.count < TOUCH_HISTORY) predictor.count++;
+
+}
+
+
+/*
+
+*   works out where the finger will be at displayTime. the velocity is a least squares fit over the recent samples
+
+*   (so one noisy sample doesn't throw it off) and is added to the newest sample (so there is no smoothing lag)
+
+*/
+
+void predictTouch(const TouchPredictor& predictor, unsigned long displayTime, float& x, float& y) {
+
+    const InputSample& latest = predictor.samples[predictor.newest];
+
+    x = latest.x;
+
+    y = latest.y;
+
+
+    // sums for the least squares fit, times are relative to the newest sample
+
+    float sumT = 0, sumX = 0, sumY = 0, sumTT = 0, sumTX = 0, sumTY = 0;
+
+    int used = 0;
+
+    for (int i = 0; i < predictor.count; i++) {
+
+        const InputSample& sample = predictor.samples[(predictor.newest - i + TOUCH_HISTORY) % TOUCH_HISTORY];
+
+        if (latest.time - sample.time > TOUCH_HISTORY_MS) break;
+
+
+        float t = -(float)(latest.time - sample.time);
+
+        sumT += t;
+
+        sumX += sample.x;
+
+        sumY += sample.y;
+
+        sumTT += t*t;
+
+        sumTX += t*sample.x;
+
+        sumTY += t*sample.y;
+
+        used++;
+
+    }
+
+
+    // need a few samples spread over time to trust a velocity
+
+    float denominator = used*sumTT - sumT*sumT;
+
+    if (used < 3 || denominator < 1) return;
+
+
+    float velocityX = (used*sumTX - sumT*sumX) / denominator;
+
+    float velocityY = (used*sumTY - sumT*sumY) / denominator;
+
+    if (velocityX*velocityX + velocityY*velocityY < TOUCH_JITTER_SPEED*TOUCH_JITTER_SPEED) return;
+
+
+    // move ahead along the path, but not too far
+
+    float ahead = displayTime > latest.time ? displayTime - latest.time : 0;
+
+    if (ahead > MAX_PREDICTION_MS) ahead = MAX_PREDICTION_MS;
+
+
+    float moveX = velocityX * ahead;
+
+    float moveY = velocityY * ahead;
+
+    float distance = sqrt(moveX*moveX + moveY*moveY);
+
+    if (distance > MAX_PREDICTION_DISTANCE) {
+
+        moveX *= MAX_PREDICTION_DISTANCE / distance;
+
+        moveY *= MAX_PREDICTION_DISTANCE / distance;
+
+    }
+
+
+    x += moveX;
+
+    y += moveY;
+
+
+    // the finger can't be off the screen
+
+    if (x < 0) x = 0;
+
+    if (x > WINDOW_WIDTH - 1) x = WINDOW_WIDTH - 1;
+
+    if (y < 0) y = 0;
+
+    if (y > WINDOW_HEIGHT - 1) y = WINDOW_HEIGHT - 1;
+
+}
+
+
+#ifdef LATENCY_STATS
+
+
+// shows the touch latency percentiles along the bottom of the screen
+
+void drawLatencyOverlay(const LatencyStats& stats) {
+
+    int y = WINDOW_HEIGHT - CHAR_HEIGHT;
+
+
+    LCD.SetFontColor(WHITE);
+
+    LCD.WriteAt("Lag p50", 0, y);
+
+    LCD.WriteAt(latencyPercentile(stats.touchToPresent, 50), 8*CHAR_WIDTH, y);
+
+    LCD.WriteAt("p99", 12*CHAR_WIDTH, y);
+
+    LCD.WriteAt(latencyPercentile(stats.touchToPresent, 99), 16*CHAR_WIDTH, y);
+
+    invalidateRectangle(0, y, 20*CHAR_WIDTH, CHAR_HEIGHT);
+
+}
+
+
+/*
+
+*   adds both histograms for this game to the end of the log, one "name,ms,count" line per bucket that was used
+
+*/
+
+void writeLatencyLog(const char fileName[], const LatencyStats& stats) {
+
+    FILE* file = fopen(fileName, "a");
+
+    if (file == NULL) return;
+
+
+    const LatencyHistogram* histograms[2] = {&stats.touchToPresent, &stats.frameTime};
+
+    const char names[2][20] = {"touch_to_present", "frame_time"};
+
+
+    for (int h = 0; h < 2; h++) {
+
+        fprintf(file, "%s,p50,%d,p99,%d,samples,%u\n", names[h], latencyPercentile(*histograms[h], 50), latencyPercentile(*histograms[h], 99), histograms[h]->total);
+
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+
+            if (histograms[h]->count[i] > 0) fprintf(file, "%s,%d,%u\n", names[h], i, histograms[h]->count[i]);
+
+        }
+
+    }
+
+
+    fclose(file);
+
+}
+
+
+#else
+
+
+// latency stats turned off, the histograms are still kept (they're cheap) but not shown or saved
+
+inline void drawLatencyOverlay(const LatencyStats&) {}
+
+inline void writeLatencyLog(const char[], const LatencyStats&) {}
+
+
+#endif
+
+
+/*
+
+*   the wave script says which enemies there are and when they show up, so waves can be changed without touching code.
+
+*   it's read from wavesFEH.txt if there is one next to the game, otherwise DEFAULT_WAVE_SCRIPT is used.
+
+*   one thing per line, # starts a comment:
+
+*
+
+*   enemy <name> health <at level 0> <per level> speed <at level 0> <per level> damage <at level 0> <per level> [boss]
+
+*   hard <health multiplier for hard mode>
+
+*   every <ms> [faster <ms per level> min <ms>] spawn <count> <enemy> [scale <level multiplier>] [from <level>] [now]
+
+*   at <ms> spawn <count> <enemy> [over <ms>] [scale <level multiplier>]
+
+*   on <level> spawn <count> <enemy> [scale <level multiplier>]
+
+*
+
+*   every repeats for the whole game (now means the first one comes right away instead of after one interval),
+
+*   at is timed from the start of the game (over spreads the count out evenly) and on happens once the player
+
+*   reaches that level. enemies are made at the player's level times scale, rounded down.
+
+*   all the at waves together can't have more than MAX_SCHEDULED_SPAWNS enemies
+
+*/
+
+const char DEFAULT_WAVE_SCRIPT[] =
+
+    "enemy grunt health 1 1 speed 0.4 0.04 damage 5 1\n"
+
+    "enemy boss health 4 2 speed 0.2 0.02 damage 10 2 boss\n"
+
+    "hard 1.3\n"
+
+    "# one enemy right away and then every 4 seconds, 0.2 seconds sooner each level down to 1 second\n"
+
+    "every 4000 faster 200 min 1000 spawn 1 grunt now\n"
+
+    "# three weaker enemies every 26 seconds once past level 0\n"
+
+    "every 26000 spawn 3 grunt scale 0.5 from 1\n"
+
+    "every 63000 spawn 1 boss\n";
+
+
+const int MAX_WAVE_ENEMIES = 8;
+
+const int MAX_WAVES = 32;
+
+// at waves become one scheduled spawn per enemy, this caps all of them together (800 KB of schedule)
+
+const int MAX_SCHEDULED_SPAWNS = 100000;
+
+
+// an enemy archetype, stats are what they are at level 0 plus some more for every level
+
+struct WaveEnemy {
+
+    char name[16];
+
+    int health, healthPerLevel;
+
+    double speed, speedPerLevel;
+
+    int damage, damagePerLevel;
+
+    bool boss;
+
+};
+
+
+enum WaveKind {WAVE_EVERY, WAVE_AT, WAVE_ON};
+
+
+struct Wave {
+
+    int kind;
+
+    int enemy; // index into the script's enemies
+
+    int count;
+
+    float scale;
+
+    int time; // interval for every, start for at, level for on
+
+    int faster, minInterval; // every only
+
+    int fromLevel; // every only
+
+    bool now; // every only
+
+    int over; // at only
+
+};
+
+
+// one enemy from an at wave, due time ms after the game started
+
+struct ScheduledSpawn {
+
+    unsigned int time;
+
+    int wave;
+
+};
+
+
+/*
+
+*   a wave script compiled for the game to run through. the at waves are turned into one scheduled spawn per enemy,
+
+*   sorted by time, so each tick only looks at the spawns that are due. on waves are sorted by level the same way,
+
+*   and every waves are kept in their own list since they come back around
+
+*/
+
+struct WaveScript {
+
+    float hardHealth;
+
+    int enemyCount;
+
+    WaveEnemy enemies[MAX_WAVE_ENEMIES];
+
+    int waveCount;
+
+    Wave waves[MAX_WAVES];
+
+
+    int repeatingCount;
+
+    int repeating[MAX_WAVES]; // the every waves
+
+    int levelWaveCount;
+
+    int levelWaves[MAX_WAVES]; // the on waves, lowest level first
+
+    int scheduleCount;
+
+    ScheduledSpawn* schedule; // the at waves, earliest first
+
+};
+
+
+WaveScript waveScript;
+
+
+// finds an enemy archetype by name, -1 if there isn't one
+
+int findWaveEnemy(const WaveScript& script, const char name[]) {
+
+    for (int i = 0; i < script.enemyCount; i++) {
+
+        if (strcmp(script.enemies[i].name, name) == 0) return i;
+
+    }
+
+    return -1;
+
+}
+
+
+// reads the next word of a line as a number, false if there isn't one
+
+bool nextInt(int& value) {
+
+    char* word = strtok(NULL, " \t\r\n");
+
+    return word != NULL && sscanf(word, "%d", &value) == 1;
+
+}
+
+bool nextDouble(double& value) {
+
+    char* word = strtok(NULL, " \t\r\n");
+
+    return word != NULL && sscanf(word, "%lf", &value) == 1;
+
+}
+
+
+/*
+
+*   adds one line of a wave script. returns false if the line doesn't make sense
+
+*/
+
+bool parseWaveLine(WaveScript& script, char line[]) {
+
+    char* word = strtok(line, " \t\r\n");
+
+    if (word == NULL || word[0] == '#') return true;
+
+
+    if (strcmp(word, "enemy") == 0) {
+
+        if (script.enemyCount >= MAX_WAVE_ENEMIES) return false;
+
+        WaveEnemy& enemy = script.enemies[script.enemyCount];
+
+
+        char* name = strtok(NULL, " \t\r\n");
+
+        if (name == NULL || strlen(name) >= sizeof(enemy.name)) return false;
+
+        strcpy(enemy.name, name);
+
+
+        char* health = strtok(NULL, " \t\r\n");
+
+        if (health == NULL || strcmp(health, "health") != 0 || !nextInt(enemy.health) || !nextInt(enemy.healthPerLevel)) return false;
+
+        char* speed = strtok(NULL, " \t\r\n");
+
+        if (speed == NULL || strcmp(speed, "speed") != 0 || !nextDouble(enemy.speed) || !nextDouble(enemy.speedPerLevel)) return false;
+
+        char* damage = strtok(NULL, " \t\r\n");
+
+        if (damage == NULL || strcmp(damage, "damage") != 0 || !nextInt(enemy.damage) || !nextInt(enemy.damagePerLevel)) return false;
+
+
+        char* boss = strtok(NULL, " \t\r\n");
+
+        enemy.boss = boss != NULL && strcmp(boss, "boss") == 0;
+
+        if (boss != NULL && !enemy.boss) return false;
+
+
+        script.enemyCount++;
+
+        return true;
+
+    }
+
+
+    if (strcmp(word, "hard") == 0) {
+
+        double multiplier;
+
+        if (!nextDouble(multiplier)) return false;
+
+        script.hardHealth = multiplier;
+
+        return true;
+
+    }
+
+
+    if (script.waveCount >= MAX_WAVES) return false;
+
+    Wave wave = {};
+
+    wave.scale = 1;
+
+    wave.minInterval = 1;
+
+
+    if (strcmp(word, "every") == 0) {
+
+        wave.kind = WAVE_EVERY;
+
+    } else if (strcmp(word, "at") == 0) {
+
+        wave.kind = WAVE_AT;
+
+    } else if (strcmp(word, "on") == 0) {
+
+        wave.kind = WAVE_ON;
+
+    } else {
+
+        return false;
+
+    }
+
+    if (!nextInt(wave.time) || wave.time < 0) return false;
+
+
+    // the rest is keywords, each followed by what it needs
+
+    bool spawns = false;
+
+    while ((word = strtok(NULL, " \t\r\n")) != NULL) {
+
+        if (strcmp(word, "spawn") == 0) {
+
+            char* name;
+
+            if (!nextInt(wave.count) || wave.count < 0 || (name = strtok(NULL, " \t\r\n")) == NULL) return false;
+
+            wave.enemy = findWaveEnemy(script, name);
+
+            if (wave.enemy < 0) return false;
+
+            spawns = true;
+
+        } else if (strcmp(word, "scale") == 0) {
+
+            double scale;
+
+            if (!nextDouble(scale) || scale < 0) return false;
+
+            wave.scale = scale;
+
+        } else if (strcmp(word, "faster") == 0 && wave.kind == WAVE_EVERY) {
+
+            if (!nextInt(wave.faster)) return false;
+
+        } else if (strcmp(word, "min") == 0 && wave.kind == WAVE_EVERY) {
+
+            if (!nextInt(wave.minInterval) || wave.minInterval < 1) return false;
+
+        } else if (strcmp(word, "from") == 0 && wave.kind == WAVE_EVERY) {
+
+            if (!nextInt(wave.fromLevel)) return false;
+
+        } else if (strcmp(word, "now") == 0 && wave.kind == WAVE_EVERY) {
+
+            wave.now = true;
+
+        } else if (strcmp(word, "over") == 0 && wave.kind == WAVE_AT) {
+
+            if (!nextInt(wave.over) || wave.over < 0) return false;
+
+        } else {
+
+            return false;
+
+        }
+
+    }
+
+    if (!spawns) return false;
+
+
+    // every enemy of an at wave gets a spot in the schedule, so their counts together can't go past the cap
+
+    if (wave.kind == WAVE_AT) {
+
+        long long scheduled = wave.count;
+
+        for (int i = 0; i < script.waveCount; i++) {
+
+            if (script.waves[i].kind == WAVE_AT) scheduled += script.waves[i].count;
+
+        }
+
+        if (scheduled > MAX_SCHEDULED_SPAWNS) return false;
+
+    }
+
+
+    script.waves[script.waveCount++] = wave;
+
+    return true;
+
+}
+
+
+// qsort order for the schedule, by time and then by the order the waves are written in
+
+int compareScheduledSpawns(const void* a, const void* b) {
+
+    const ScheduledSpawn* first = (const ScheduledSpawn*)a;
+
+    const ScheduledSpawn* second = (const ScheduledSpawn*)b;
+
+    if (first->time != second->time) return first->time < second->time ? -1 : 1;
+
+    return first->wave - second->wave;
+
+}
+
+
+/*
+
+*   turns the parsed waves into the lists the game runs through: every waves in a list, on waves sorted by level,
+
+*   and each enemy of every at wave as its own scheduled spawn, sorted by time
+
+*/
+
+void compileWaveScript(WaveScript& script) {
+
+    script.repeatingCount = 0;
+
+    script.levelWaveCount = 0;
+
+    script.scheduleCount = 0;
+
+    for (int i = 0; i < script.waveCount; i++) {
+
+        Wave& wave = script.waves[i];
+
+        if (wave.kind == WAVE_EVERY) {
+
+            script.repeating[script.repeatingCount++] = i;
+
+        } else if (wave.kind == WAVE_ON) {
+
+            // insertion sort, there are only ever a few
+
+            int j = script.levelWaveCount++;
+
+            while (j > 0 && script.waves[script.levelWaves[j - 1]].time > wave.time) {
+
+                script.levelWaves[j] = script.levelWaves[j - 1];
+
+                j--;
+
+            }
+
+            script.levelWaves[j] = i;
+
+        } else {
+
+            script.scheduleCount += wave.count;
+
+        }
+
+    }
+
+
+    script.schedule = new ScheduledSpawn[script.scheduleCount];
+
+    int spawn = 0;
+
+    for (int i = 0; i < script.waveCount; i++) {
+
+        Wave& wave = script.waves[i];
+
+        if (wave.kind != WAVE_AT) continue;
+
+        for (int j = 0; j < wave.count; j++) {
+
+            script.schedule[spawn].time = wave.time + (long long)wave.over * j / wave.count;
+
+            script.schedule[spawn].wave = i;
+
+            spawn++;
+
+        }
+
+    }
+
+    qsort(script.schedule, script.scheduleCount, sizeof(ScheduledSpawn), compareScheduledSpawns);
+
+}
+
+
+// parses a whole script, false (with the line number in line) if any line doesn't make sense
+
+bool parseWaveScript(WaveScript& script, const char text[], int& line) {
+
+    delete[] script.schedule;
+
+    script = WaveScript();
+
+    script.hardHealth = 1;
+
+
+    line = 0;
+
+    while (*text != '\0') {
+
+        line++;
+
+
+        // copy the line out, strtok writes into it
+
+        char buffer[256];
+
+        int length = strcspn(text, "\n");
+
+        if (length >= (int)sizeof(buffer)) return false;
+
+        memcpy(buffer, text, length);
+
+        buffer[length] = '\0';
+
+        text += length;
+
+        if (*text == '\n') text++;
+
+
+        if (!parseWaveLine(script, buffer)) return false;
+
+    }
+
+
+    compileWaveScript(script);
+
+    return true;
+
+}
+
+
+/*
+
+*   loads and compiles the wave script, from fileName if it's there. if the file has a mistake it says which line
+
+*   and uses the default script instead
+
+*/
+
+void loadWaveScript(const char fileName[]) {
+
+    int line;
+
+    FILE* file = fopen(fileName, "rb");
+
+    if (file != NULL) {
+
+        fseek(file, 0, SEEK_END);
+
+        long size = ftell(file);
+
+        fseek(file, 0, SEEK_SET);
+
+
+        char* text = new char[size + 1];
+
+        bool ok = fread(text, 1, size, file) == (size_t)size;
+
+        text[ok ? size : 0] = '\0';
+
+        fclose(file);
+
+
+        ok = ok && parseWaveScript(waveScript, text, line);
+
+        delete[] text;
+
+        if (ok) return;
+
+        fprintf(stderr, "%s line %d doesn't make sense, using the default waves\n", fileName, line);
+
+    }
+
+
+    parseWaveScript(waveScript, DEFAULT_WAVE_SCRIPT, line);
+
+}
+
+
+// makes one enemy of an archetype at a random spot on the edge of the screen (with the rest of the game's functions)
+
+void spawnEnemy(EnemyArchetype& enemies, const WaveEnemy& archetype, int level, float healthModifier);
+
+
+/*
+
+*   everything that makes up one play session
+
+*/
+
+struct GameState {
+
+    int score = 0;
+
+    int xpToNextLevel = 5;
+
+    bool hardMode = false;
+
+
+    PlayerArchetype player = {};
+
+    // used for drawing player sprite flipped if facing left
+
+    bool playerFacingRight = true;
+
+
+    // the items struct and timers for each cooldown based item
+
+    Items items;
+
+    unsigned long marbleTimer = 0;
+
+    unsigned long airfoilTimer = 0;
+
+    unsigned long circuitTimer = 0;
+
+
+    // every enemy on screen
+
+    EnemyArchetype enemies = {};
+
+
+    // how far into the wave script the game is: when it started, the next at spawn and on wave,
+
+    // and when each every wave last spawned
+
+    unsigned long waveStartTime = 0;
+
+    int waveCursor = 0;
+
+    int waveLevelCursor = 0;
+
+    unsigned long waveTimers[MAX_WAVES] = {};
+
+
+    // every attack on screen
+
+    AttackArchetype attacks = {};
+
+
+    // counts loop iterations, attacks work out their position from this
+
+    unsigned long tick = 0;
+
+};
+
+
+/*
+
+*   systems. each one walks only the component arrays it needs, and tickGame runs them in the same order every tick:
+
+*   waveSystem, pathSystem, seekSystem + moveSystem (enemies), contactSystem, cooldownSystem, beamHitSystem, attackHitSystem,
+
+*   enemyDeathSystem, attackDeathSystem, then after the level up check facingSystem, animationSystem,
+
+*   renderSystem + hitFlashSystem add the frame to the draw list
+
+*/
+
+
+/*
+
+*   spawns whatever the wave script says is due: every waves whose interval has passed (it gets shorter by faster
+
+*   each level, down to min), then the scheduled at spawns up to now and the on waves up to the player's level.
+
+*   both of those are sorted, so only the ones that are due get looked at
+
+*/
+
+void waveSystem(GameState& state, const WaveScript& script) {
+
+    unsigned long now = TimeNowMSec();
+
+    int level = state.player.level;
+
+    float healthModifier = state.hardMode ? script.hardHealth : 1;
+
+
+    for (int i = 0; i < script.repeatingCount; i++) {
+
+        const Wave& wave = script.waves[script.repeating[i]];
+
+        if (level < wave.fromLevel) continue;
+
+
+        int interval = wave.time - wave.faster*level;
+
+        if (interval < wave.minInterval) interval = wave.minInterval;
+
+        if (now - state.waveTimers[i] > (unsigned long)interval) {
+
+            state.waveTimers[i] = now;
+
+            for (int j = 0; j < wave.count; j++) {
+
+                spawnEnemy(state.enemies, script.enemies[wave.enemy], (int)(level * wave.scale), healthModifier);
+
+            }
+
+        }
+
+    }
+
+
+    unsigned long elapsed = now - state.waveStartTime;
+
+    while (state.waveCursor < script.scheduleCount && script.schedule[state.waveCursor].time <= elapsed) {
+
+        const Wave& wave = script.waves[script.schedule[state.waveCursor].wave];
+
+        spawnEnemy(state.enemies, script.enemies[wave.enemy], (int)(level * wave.scale), healthModifier);
+
+        state.waveCursor++;
+
+    }
+
+
+    while (state.waveLevelCursor < script.levelWaveCount && script.waves[script.levelWaves[state.waveLevelCursor]].time <= level) {
+
+        const Wave& wave = script.waves[script.levelWaves[state.waveLevelCursor]];
+
+        for (int j = 0; j < wave.count; j++) {
+
+            spawnEnemy(state.enemies, script.enemies[wave.enemy], (int)(level * wave.scale), healthModifier);
+
+        }
+
+        state.waveLevelCursor++;
+
+    }
+
+}
+
+
+// points each row's velocity at (targetX, targetY) at its speed and turns it to face there, close enough means stop
+
+void seekSystem(Transform transform[], Velocity velocity[], int count, Real targetX, Real targetY) {
+
+    for (int i = 0; i < count; i++) {
+
+        // calculate the x and y component sizes from the current position to the desired position
+
+        Real xDiff = targetX - transform[i].x;
+
+        Real yDiff = targetY - transform[i].y;
+
+
+        transform[i].angle = realAtan2(yDiff, xDiff);
+
+
+        // don't move if close enough to the desired point (prevents position flickering)
+
+        Real length = realLength(xDiff, yDiff);
+
+        if (length <= 4) {
+
+            velocity[i].x = 0;
+
+            velocity[i].y = 0;
+
+        } else {
+
+            velocity[i].x = xDiff / length * velocity[i].speed;
+
+            velocity[i].y = yDiff / length * velocity[i].speed;
+
+        }
+
+    }
+
+}
+
+
+// moves each row by its velocity, locking it to the edge so it doesn't go offscreen
+
+void moveSystem(Transform transform[], const Velocity velocity[], int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        Transform& t = transform[i];
+
+        t.x += velocity[i].x;
+
+        t.y += velocity[i].y;
+
+
+        if (t.x > WINDOW_WIDTH - t.width) t.x = WINDOW_WIDTH - t.width;
+
+        if (t.x < 0) t.x = 0;
+
+        if (t.y > WINDOW_HEIGHT - t.height) t.y = WINDOW_HEIGHT - t.height;
+
+        if (t.y < 0) t.y = 0;
+
+    }
+
+}
+
+
+// drops the attacks that have gone off screen (they are at the front), then puts the rest where their path says
+
+void pathSystem(AttackArchetype& attacks, unsigned long tick) {
+
+    int expired = 0;
+
+    while (expired < attacks.count && attacks.path[expired].expireTick <= tick) {
+
+        expired++;
+
+    }
+
+    if (expired > 0) removeAttacks(attacks, 0, expired);
+
+
+    for (int i = 0; i < attacks.count; i++) {
+
+        Real elapsed = (int)(tick - attacks.path[i].spawnTick);
+
+        attacks.transform[i].x = attacks.path[i].originX + attacks.velocity[i].x * elapsed;
+
+        attacks.transform[i].y = attacks.path[i].originY + attacks.velocity[i].y * elapsed;
+
+    }
+
+}
+
+
+// enemies touching the player hurt it. returns true if that killed the player
+
+bool contactSystem(GameState& state) {
+
+    EnemyArchetype& enemies = state.enemies;
+
+    for (int i = 0; i < enemies.count; i++) {
+
+        if (isColliding(enemies.transform[i], state.player.transform)) {
+
+            state.player.health.health -= enemies.damage[i].amount;
+
+            logPlayerHurt(enemies.damage[i].kind, enemies.damage[i].amount);
+
+        }
+
+    }
+
+    return state.player.health.health < 1;
+
+}
+
+
+// counts down the invincibility of enemies that were hit recently
+
+void cooldownSystem(Cooldown cooldown[], int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        if (cooldown[i].active) {
+
+            cooldown[i].ticks--;
+
+            if (cooldown[i].ticks < 0) {
+
+                cooldown[i].ticks = ENEMY_HIT_COOLDOWN;
+
+                cooldown[i].active = false;
+
+            }
+
+        }
+
+    }
+
+}
+
+
+// hurts an enemy that isn't invincible, with sparks and a damage number. returns false if it was invincible
+
+bool hitEnemy(EnemyArchetype& enemies, int i, int damage, int weapon, float sparkX, float sparkY, unsigned int sparkColor, Particles& particles) {
+
+    if (enemies.cooldown[i].active) return false;
+
+
+    enemies.cooldown[i].active = true;
+
+    enemies.health[i].health -= damage;
+
+    enemies.damage[i].lastHitBy = weapon;
+
+
+    emitParticles(particles, sparkX, sparkY, 6, 1.5, 16, sparkColor);
+
+    emitDamageNumber(particles, (float)enemies.transform[i].x, (float)enemies.transform[i].y - 12, damage);
+
+    return true;
+
+}
+
+
+// the beam hits enemies at its end and halfway down (ugly but works)
+
+void beamHitSystem(GameState& state, Particles& particles) {
+
+    if (state.items.beam.level < 0) return;
+
+
+    Beam& beam = state.items.beam;
+
+    Transform& player = state.player.transform;
+
+
+    // center of the player and the beam vector
+
+    Real centerX = player.x + player.width/2;
+
+    Real centerY = player.y + player.height/2;
+
+    Real beamX = Real(beam.length[beam.level]) * realCos(player.angle);
+
+    Real beamY = Real(beam.length[beam.level]) * realSin(player.angle);
+
+
+    EnemyArchetype& enemies = state.enemies;
+
+    for (int i = 0; i < enemies.count; i++) {
+
+        if (isCollidingWithPoint(enemies.transform[i], centerX + beamX, centerY + beamY) ||
+
+        isCollidingWithPoint(enemies.transform[i], centerX + beamX / 2, centerY + beamY / 2)) {
+
+            Transform& t = enemies.transform[i];
+
+            hitEnemy(enemies, i, beam.damage[beam.level], ITEM_BEAM, (float)t.x + t.width/2, (float)t.y + t.height/2, beam.color[beam.level], particles);
+
+        }
+
+    }
+
+}
+
+
+// attacks touching an enemy hurt it and lose a hit
+
+void attackHitSystem(GameState& state, Particles& particles) {
+
+    EnemyArchetype& enemies = state.enemies;
+
+    AttackArchetype& attacks = state.attacks;
+
+    for (int i = 0; i < enemies.count; i++) {
+
+        for (int j = 0; j < attacks.count; j++) {
+
+            if (isColliding(enemies.transform[i], attacks.transform[j]) &&
+
+            hitEnemy(enemies, i, attacks.damage[j].amount, attacks.damage[j].kind, (float)attacks.transform[j].x, (float)attacks.transform[j].y, GOLD, particles)) {
+
+                attacks.health[j].health--;
+
+            }
+
+        }
+
+    }
+
+}
+
+
+// removes dead enemies, giving the player xp, score and lab report healing for each
+
+void enemyDeathSystem(GameState& state, Particles& particles) {
+
+    EnemyArchetype& enemies = state.enemies;
+
+    for (int i = 0; i < enemies.count; i++) {
+
+        if (enemies.health[i].health > 0) continue;
+
+
+        logTelemetry(TELEMETRY_ENEMY_KILLED, enemies.damage[i].lastHitBy, enemies.damage[i].kind);
+
+
+        // death burst
+
+        Transform& t = enemies.transform[i];
+
+        emitParticles(particles, (float)t.x + t.width/2, (float)t.y + t.height/2, 24, 2.5, 30, RED);
+
+
+        removeEnemy(enemies, i);
+
+        i--;
+
+
+        // grant player XP
+
+        state.player.xp++;
+
+
+        // if player has Lab Report item, heal them on enemy death
+
+        if (state.items.report.level > -1) {
+
+            state.player.health.health += state.items.report.healing[state.items.report.level];
+
+        }
+
+
+        state.score += 10;
+
+    }
+
+}
+
+
+// removes attacks that have used up all their hits
+
+void attackDeathSystem(AttackArchetype& attacks) {
+
+    for (int i = 0; i < attacks.count; i++) {
+
+        if (attacks.health[i].health < 1) {
+
+            removeAttacks(attacks, i, 1);
+
+            i--;
+
+        }
+
+    }
+
+}
+
+
+// flips each row's sprite to face the way it is heading (sprites face right)
+
+void facingSystem(Transform transform[], int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        transform[i].mirrored = !(transform[i].angle > -M_PI_2 && transform[i].angle < M_PI_2);
+
+    }
+
+}
+
+
+// moves each animation along one tick and points its sprite at the current frame
+
+void animationSystem(Animation animation[], SpriteId sprite[], int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        Animation& a = animation[i];
+
+        a.ticks++;
+
+        if (a.ticks >= a.frameTicks) {
+
+            a.ticks = 0;
+
+            a.frame++;
+
+            if (a.frame >= a.frameCount) a.frame = 0;
+
+        }
+
+        sprite[i].sprite = a.sheet + a.frame;
+
+    }
+
+}
+
+
+// switches to another animation, carrying on if it's already the one playing
+
+void playAnimation(Animation& animation, const Animation& play) {
+
+    if (animation.sheet != play.sheet) animation = play;
+
+}
+
+
+// adds a draw of each row's sprite on layer
+
+void renderSystem(DrawList& list, int layer, const Transform transform[], const SpriteId sprite[], int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        SpriteHandle handle = entitySpriteHandles[sprite[i].sprite][transform[i].mirrored];
+
+        drawSpriteCommand(list, layer, handle, (int)transform[i].x, (int)transform[i].y);
+
+    }
+
+}
+
+
+// adds a white box over enemies hit this tick so theres a hit 'animation'
+
+void hitFlashSystem(DrawList& list, const Transform transform[], const Cooldown cooldown[], int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        if (cooldown[i].active && cooldown[i].ticks == ENEMY_HIT_COOLDOWN) {
+
+            drawRectangleCommand(list, LAYER_HIT_FLASH, (int)transform[i].x, (int)transform[i].y, transform[i].width, transform[i].height, WHITE);
+
+        }
+
+    }
+
+}
+
+
+/*
+
+*   the whole game state as plain data, used for saving, loading and rewinding.
+
+*   timers are stored as how long ago they went off so a snapshot can be loaded at any time
+
+*/
+
+struct GameSnapshot {
+
+    unsigned int tick;
+
+    int score, xpToNextLevel, hardMode, playerFacingRight;
+
+    PlayerArchetype player;
+
+    Items items;
+
+    unsigned int marbleElapsed, airfoilElapsed, circuitElapsed;
+
+    unsigned int waveElapsed;
+
+    int waveCursor, waveLevelCursor;
+
+    unsigned int waveTimerElapsed[MAX_WAVES];
+
+    EnemyArchetype enemies;
+
+    AttackArchetype attacks;
+
+    unsigned int randomState;
+
+};
+
+
+// snapshots get compared a word at a time
+
+const int SNAPSHOT_WORDS = sizeof(GameSnapshot) / 4;
+
+static_assert(sizeof(GameSnapshot) % 4 == 0, "snapshots have to be whole words");
+
+
+/*
+
+*   copies the game state into a snapshot. unused enemy and attack rows are always zero
+
+*   so snapshots of similar moments are mostly the same bytes (which is what makes the rewind deltas small)
+
+*/
+
+void saveSnapshot(GameState& state, GameSnapshot& snapshot) {
+
+    unsigned long now = TimeNowMSec();
+
+
+    memset((void*)&snapshot, 0, sizeof(GameSnapshot));
+
+
+    snapshot.tick = state.tick;
+
+    snapshot.score = state.score;
+
+    snapshot.xpToNextLevel = state.xpToNextLevel;
+
+    snapshot.hardMode = state.hardMode;
+
+    snapshot.playerFacingRight = state.playerFacingRight;
+
+    snapshot.player = state.player;
+
+    snapshot.items = state.items;
+
+
+    snapshot.marbleElapsed = now - state.marbleTimer;
+
+    snapshot.airfoilElapsed = now - state.airfoilTimer;
+
+    snapshot.circuitElapsed = now - state.circuitTimer;
+
+
+    snapshot.waveElapsed = now - state.waveStartTime;
+
+    snapshot.waveCursor = state.waveCursor;
+
+    snapshot.waveLevelCursor = state.waveLevelCursor;
+
+    for (int i = 0; i < MAX_WAVES; i++) {
+
+        snapshot.waveTimerElapsed[i] = now - state.waveTimers[i];
+
+    }
+
+
+    snapshot.enemies = state.enemies;
+
+    snapshot.attacks = state.attacks;
+
+
+    snapshot.randomState = gameRandom.state;
+
+}
+
+
+/*
+
+*   puts the game back to how it was in a snapshot, with every timer picking up where it left off
+
+*/
+
+void loadSnapshot(GameState& state, const GameSnapshot& snapshot) {
+
+    unsigned long now = TimeNowMSec();
+
+
+    state.tick = snapshot.tick;
+
+    state.score = snapshot.score;
+
+    state.xpToNextLevel = snapshot.xpToNextLevel;
+
+    state.hardMode = snapshot.hardMode;
+
+    state.playerFacingRight = snapshot.playerFacingRight;
+
+    state.player = snapshot.player;
+
+    state.items = snapshot.items;
+
+
+    state.marbleTimer = now - snapshot.marbleElapsed;
+
+    state.airfoilTimer = now - snapshot.airfoilElapsed;
+
+    state.circuitTimer = now - snapshot.circuitElapsed;
+
+
+    state.waveStartTime = now - snapshot.waveElapsed;
+
+    state.waveCursor = snapshot.waveCursor;
+
+    state.waveLevelCursor = snapshot.waveLevelCursor;
+
+    for (int i = 0; i < MAX_WAVES; i++) {
+
+        state.waveTimers[i] = now - snapshot.waveTimerElapsed[i];
+
+    }
+
+
+    state.enemies = snapshot.enemies;
+
+    state.attacks = snapshot.attacks;
+
+
+    gameRandom.state = snapshot.randomState;
+
+}
+
+
+// first bytes of a snapshot file, the version goes up whenever GameSnapshot changes
+
+const char SNAPSHOT_MAGIC[4] = {'F', 'E', 'H', 'S'};
+
+const int SNAPSHOT_VERSION = 7;
+
+
+// float and fixed point snapshots are the same size but can't be read as each other, so the file says which it is
+
+#ifdef FIXED_POINT_PHYSICS
+
+const int SNAPSHOT_PHYSICS = 1;
+
+#else
+
+const int SNAPSHOT_PHYSICS = 0;
+
+#endif
+
+
+/*
+
+*   writes a snapshot to a file so a session can be picked back up later. returns false if it couldn't
+
+*/
+
+bool writeSnapshotFile(const char fileName[], const GameSnapshot& snapshot) {
+
+    FILE* file = fopen(fileName, "wb");
+
+    if (file == NULL) return false;
+
+
+    int size = sizeof(GameSnapshot);
+
+    bool ok = fwrite(SNAPSHOT_MAGIC, 4, 1, file) == 1 &&
+
+        fwrite(&SNAPSHOT_VERSION, sizeof(int), 1, file) == 1 &&
+
+        fwrite(&SNAPSHOT_PHYSICS, sizeof(int), 1, file) == 1 &&
+
+        fwrite(&size, sizeof(int), 1, file) == 1 &&
+
+        fwrite(&snapshot, sizeof(GameSnapshot), 1, file) == 1;
+
+
+    fclose(file);
+
+    return ok;
+
+}
+
+
+/*
+
+*   reads a snapshot written by writeSnapshotFile. returns false if the file is missing, from a different version
+
+*   or from a build with the other kind of physics
+
+*/
+
+bool readSnapshotFile(const char fileName[], GameSnapshot& snapshot) {
+
+    FILE* file = fopen(fileName, "rb");
+
+    if (file == NULL) return false;
+
+
+    char magic[4];
+
+    int version, physics, size;
+
+    bool ok = fread(magic, 4, 1, file) == 1 &&
+
+        fread(&version, sizeof(int), 1, file) == 1 &&
+
+        fread(&physics, sizeof(int), 1, file) == 1 &&
+
+        fread(&size, sizeof(int), 1, file) == 1 &&
+
+        memcmp(magic, SNAPSHOT_MAGIC, 4) == 0 &&
+
+        version == SNAPSHOT_VERSION &&
+
+        physics == SNAPSHOT_PHYSICS &&
+
+        size == sizeof(GameSnapshot) &&
+
+        fread(&snapshot, sizeof(GameSnapshot), 1, file) == 1;
+
+
+    fclose(file);
+
+    return ok;
+
+}
+
+
+// rewind history sizes, with a snapshot every 15 ticks the ring holds about 16 seconds at 60 fps
+
+const int REWIND_INTERVAL = 15;
+
+const int REWIND_SLOTS = 64;
+
+const int REWIND_KEYFRAMES = 5;
+
+const int REWIND_KEYFRAME_INTERVAL = 16;
+
+// a delta that doesn't fit in this many words gets stored as a new keyframe instead
+
+const int REWIND_DELTA_WORDS = SNAPSHOT_WORDS / 4;
+
+
+/*
+
+*   ring of recent snapshots. only every REWIND_KEYFRAME_INTERVAL-th one is stored whole (a keyframe),
+
+*   the rest are stored as the XOR against their keyframe with the runs of zero words squeezed out
+
+*/
+
+struct RewindRing {
+
+    GameSnapshot keyframe[REWIND_KEYFRAMES];
+
+    int keyframeNumber[REWIND_KEYFRAMES];
+
+    int keyframesMade;
+
+
+    unsigned int delta[REWIND_SLOTS][REWIND_DELTA_WORDS];
+
+    int deltaSize[REWIND_SLOTS];
+
+    int slotKeyframe[REWIND_SLOTS];
+
+    int slotsSinceKeyframe;
+
+
+    int newest, count;
+
+
+    void clear() {
+
+        keyframesMade = 0;
+
+        slotsSinceKeyframe = 0;
+
+        newest = -1;
+
+        count = 0;
+
+    }
+
+};
+
+
+/*
+
+*   XORs the snapshot against the keyframe and writes it as (zero words << 16 | changed words) headers
+
+*   each followed by the changed words. returns the size in words, or -1 if it didn't fit
+
+*/
+
+int encodeSnapshotDelta(const GameSnapshot& snapshot, const GameSnapshot& keyframe, unsigned int delta[]) {
+
+    const unsigned int* now = (const unsigned int*)&snapshot;
+
+    const unsigned int* key = (const unsigned int*)&keyframe;
+
+
+    int size = 0;
+
+    int i = 0;
+
+    while (i < SNAPSHOT_WORDS) {
+
+        int zeros = 0;
+
+        while (i < SNAPSHOT_WORDS && now[i] == key[i] && zeros < 0xFFFF) {
+
+            zeros++;
+
+            i++;
+
+        }
+
+
+        int start = i;
+
+        int changed = 0;
+
+        while (i < SNAPSHOT_WORDS && now[i] != key[i] && changed < 0xFFFF) {
+
+            changed++;
+
+            i++;
+
+        }
+
+
+        if (size + 1 + changed > REWIND_DELTA_WORDS) return -1;
+
+
+        delta[size++] = (zeros << 16) | changed;
+
+        for (int j = start; j < i; j++) {
+
+            delta[size++] = now[j] ^ key[j];
+
+        }
+
+    }
+
+
+    return size;
+
+}
+
+
+// undoes encodeSnapshotDelta, snapshot has to start out as a copy of the keyframe
+
+void applySnapshotDelta(GameSnapshot& snapshot, const unsigned int delta[], int size) {
+
+    unsigned int* words = (unsigned int*)&snapshot;
+
+
+    int i = 0;
+
+    int d = 0;
+
+    while (d < size) {
+
+        int zeros = delta[d] >> 16;
+
+        int changed = delta[d] & 0xFFFF;
+
+        d++;
+
+
+        i += zeros;
+
+        for (int j = 0; j < changed; j++) {
+
+            words[i++] ^= delta[d++];
+
+        }
+
+    }
+
+}
+
+
+/*
+
+*   adds a snapshot to the rewind ring, overwriting the oldest one once its full
+
+*/
+
+void pushSnapshot(RewindRing& ring, const GameSnapshot& snapshot) {
+
+    ring.newest = (ring.newest + 1) % REWIND_SLOTS;
+
+    if (ring.count < REWIND_SLOTS) ring.count++;
+
+    int slot = ring.newest;
+
+
+    // try to store it as a delta against the newest keyframe
+
+    int size = -1;
+
+    if (ring.keyframesMade > 0 && ring.slotsSinceKeyframe < REWIND_KEYFRAME_INTERVAL) {
+
+        int key = (ring.keyframesMade - 1) % REWIND_KEYFRAMES;
+
+        size = encodeSnapshotDelta(snapshot, ring.keyframe[key], ring.delta[slot]);
+
+    }
+
+
+    // otherwise make it a new keyframe, which is an empty delta against itself
+
+    if (size < 0) {
+
+        int key = ring.keyframesMade % REWIND_KEYFRAMES;
+
+        ring.keyframe[key] = snapshot;
+
+        ring.keyframeNumber[key] = ring.keyframesMade;
+
+        ring.keyframesMade++;
+
+        ring.slotsSinceKeyframe = 0;
+
+        size = 0;
+
+    }
+
+
+    ring.deltaSize[slot] = size;
+
+    ring.slotKeyframe[slot] = ring.keyframesMade - 1;
+
+    ring.slotsSinceKeyframe++;
+
+}
+
+
+/*
+
+*   gets the snapshot from stepsBack pushes ago (0 is the newest).
+
+*   returns false if it's older than the ring goes back, or its keyframe has already been overwritten
+
+*/
+
+bool rewindSnapshot(RewindRing& ring, int stepsBack, GameSnapshot& snapshot) {
+
+    if (stepsBack < 0 || stepsBack >= ring.count) return false;
+
+
+    int slot = (ring.newest - stepsBack + REWIND_SLOTS) % REWIND_SLOTS;
+
+    int key = ring.slotKeyframe[slot] % REWIND_KEYFRAMES;
+
+    if (ring.keyframeNumber[key] != ring.slotKeyframe[slot]) return false;
+
+
+    snapshot = ring.keyframe[key];
+
+    applySnapshotDelta(snapshot, ring.delta[slot], ring.deltaSize[slot]);
+
+    return true;
+
+}
+
+
+#ifdef BOT
+
+
+// the bot plays difficulty BOT_HARD_MODE with a fixed seed, so the same build always plays the same runs
+
+const bool BOT_HARD_MODE = false;
+
+const unsigned int BOT_SEED = 12345;
+
+// how many games main plays before quitting
+
+const int BOT_GAMES = 10;
+
+// items the bot would rather have come first, it takes the best one the level up menu offers
+
+const int BOT_ITEM_PRIORITY[ITEM_COUNT] = {ITEM_BEAM, ITEM_MARBLE, ITEM_CIRCUIT, ITEM_REPORT, ITEM_AIRFOIL};
+
+// how hard the walls push compared to one enemy, and how far ahead of the player the bot touches
+
+const float BOT_WALL_PUSH = 6;
+
+const float BOT_STEP = 40;
+
+
+// where an item sits in BOT_ITEM_PRIORITY, lower is better
+
+int botItemRank(int item) {
+
+    for (int i = 0; i < ITEM_COUNT; i++) {
+
+        if (BOT_ITEM_PRIORITY[i] == item) return i;
+
+    }
+
+    return ITEM_COUNT;
+
+}
+
+
+/*
+
+*   stands in for LCD.Touch when the bot is playing. every enemy pushes the player away, harder the closer
+
+*   (and the more damage) it is, so the sum points away from wherever they are packed in tightest.
+
+*   the walls push too so it doesn't get pinned in a corner. returns false (no touch) if nothing is pushing
+
+*/
+
+bool botTouch(GameState& state, float& x, float& y) {
+
+    Transform& player = state.player.transform;
+
+    float centerX = (float)player.x + player.width/2;
+
+    float centerY = (float)player.y + player.height/2;
+
+
+    float pushX = 0, pushY = 0;
+
+    for (int i = 0; i < state.enemies.count; i++) {
+
+        Transform& enemy = state.enemies.transform[i];
+
+        float dx = centerX - ((float)enemy.x + enemy.width/2);
+
+        float dy = centerY - ((float)enemy.y + enemy.height/2);
+
+        // the direction scaled by 1/distance, so near enemies count far more than ones across the screen
+
+        float weight = state.enemies.damage[i].amount / (dx*dx + dy*dy + 1);
+
+        pushX += dx * weight;
+
+        pushY += dy * weight;
+
+    }
+
+
+    // walls push back like an enemy standing just outside them
+
+    pushX += BOT_WALL_PUSH * (1 / (centerX + 1) - 1 / (WINDOW_WIDTH - centerX + 1));
+
+    pushY += BOT_WALL_PUSH * (1 / (centerY + 1) - 1 / (WINDOW_HEIGHT - centerY + 1));
+
+
+    float length = sqrt(pushX*pushX + pushY*pushY);
+
+    if (length < 0.001) return false;
+
+
+    // touch a step ahead in that direction
+
+    x = centerX + pushX / length * BOT_STEP;
+
+    y = centerY + pushY / length * BOT_STEP;
+
+    if (x < 0) x = 0;
+
+    if (x > WINDOW_WIDTH - 1) x = WINDOW_WIDTH - 1;
+
+    if (y < 0) y = 0;
+
+    if (y > WINDOW_HEIGHT - 1) y = WINDOW_HEIGHT - 1;
+
+    return true;
+
+}
+
+
+#endif
+
+
+void logItemPick(Items& items, int* itemChoice);
+
+int itemFromChoice(Items& items, int* itemChoice);
+
+
+/*
+
+*   scenes. every screen is a scene on a stack, and one loop (runScenes) runs whichever is on top: it reads the touch
+
+*   screen once a time round, ticks the game or hands menus the touch, and if nothing is happening it does some loading
+
+*   or sleeps instead of spinning. a scene pushes the next one over itself and pops itself when it's done, so the menu
+
+*   is still there under a game, and the game under its level up menu
+
+*/
+
+enum SceneType {
+
+    SCENE_MAIN_MENU, SCENE_DIFFICULTY, SCENE_GAME, SCENE_LEVEL_UP, SCENE_GAME_OVER,
+
+    SCENE_STATS, SCENE_INFO, SCENE_CREDITS
+
+};
+
+
+// what a menu gets told about the touch screen: just touched, still touched, or just let go
+
+enum TouchEvent {TOUCH_NONE, TOUCH_DOWN, TOUCH_HELD, TOUCH_UP};
+
+
+struct Scene {
+
+    int type;
+
+    bool shown;   // drawn since it was pushed or last uncovered
+
+    bool pressed; // a touch started while it was on top, so the touch is meant for it
+
+};
+
+
+const int MAX_SCENES = 8;
+
+
+struct SceneStack {
+
+    Scene scenes[MAX_SCENES];
+
+    int count;
+
+};
+
+
+SceneStack sceneStack;
+
+
+// how long the loop sleeps when a menu is up and nothing is being touched or loaded
+
+const int IDLE_SLEEP_MS = 10;
+
+
+void startScene(int type);
+
+void showScene(int type);
+
+void touchScene(int type, int event, float x, float y);
+
+void startGame();
+
+void showGame();
+
+void tickGame(InputSample& input);
+
+void endGame();
+
+void showGameOver();
+
+void touchGameOver(int event, float x, float y);
+
+void startDifficultyMenu();
+
+void showDifficultyMenu();
+
+void touchDifficultyMenu(float x, float y);
+
+void startLevelUp();
+
+void showLevelUp();
+
+void touchLevelUp(float x, float y);
+
+void showMainMenu();
+
+void touchMainMenu(float x, float y);
+
+void showStats();
+
+void showInfo();
+
+void showCredits();
+
+
+// the scene on top, the one being run
+
+inline Scene& topScene() {
+
+    return sceneStack.scenes[sceneStack.count - 1];
+
+}
+
+
+// puts a scene on top and starts it (starting a scene can push or pop more)
+
+void pushScene(int type) {
+
+    if (sceneStack.count >= MAX_SCENES) return;
+
+
+    sceneStack.scenes[sceneStack.count++] = {type, false, false};
+
+    startScene(type);
+
+}
+
+
+// takes the top scene off, the one under it gets drawn again
+
+void popScene() {
+
+    if (sceneStack.count == 0) return;
+
+
+    sceneStack.count--;
+
+    if (sceneStack.count > 0) {
+
+        topScene().shown = false;
+
+        topScene().pressed = false;
+
+    }
+
+}
+
+
+// swaps the top scene for another, like going from the difficulty menu into the game
+
+void replaceScene(int type) {
+
+    popScene();
+
+    pushScene(type);
+
+}
+
+
+/*
+
+*   the one loop everything runs in, until there are no scenes left (on the Proteus the main menu never goes,
+
+*   so that's only the bot). a touch that was already down when a scene came up isn't passed to it, the same as
+
+*   each menu used to wait to be let go first
+
+*/
+
+void runScenes() {
+
+    bool wasTouching = true;
+
+    InputSample input = {};
+
+
+    while (sceneStack.count > 0) {
+
+        Scene& scene = topScene();
+
+
+        // a scene that was just pushed or uncovered draws itself first (which can change the stack again)
+
+        if (!scene.shown) {
+
+            scene.shown = true;
+
+            showScene(scene.type);
+
+            continue;
+
+        }
+
+
+        // read the touch screen once, stamped so we can tell how long it takes to show up
+
+        // (the bot touches from tickGame instead, and its menus don't wait for touches)
+
+#ifndef BOT
+
+        input.touching = LCD.Touch(&input.x, &input.y);
+
+        input.time = TimeNowMSec();
+
+#endif
+
+
+        int event = TOUCH_NONE;
+
+        if (input.touching) {
+
+            event = wasTouching ? TOUCH_HELD : TOUCH_DOWN;
+
+        } else if (wasTouching) {
+
+            event = TOUCH_UP;
+
+        }
+
+        wasTouching = input.touching;
+
+
+        // the game takes the touch screen as it is every tick
+
+        if (scene.type == SCENE_GAME) {
+
+            tickGame(input);
+
+            continue;
+
+        }
+
+
+        if (event == TOUCH_DOWN) scene.pressed = true;
+
+        if (event != TOUCH_NONE && scene.pressed) {
+
+            touchScene(scene.type, event, input.x, input.y);
+
+        } else if (!loadInBackground()) {
+
+            // nothing to do until the screen is touched
+
+            Sleep(IDLE_SLEEP_MS);
+
+        }
+
+    }
+
+}
+
+
+/*
+
+*   everything a game keeps from one tick to the next. it's global because it's too big for the stack on the Proteus
+
+*   (the rewind history and the particles used to be statics for the same reason)
+
+*/
+
+struct GameSession {
+
+    GameState state;
+
+    bool hardMode; // picked in the difficulty menu, startGame puts it in state
+
+
+    Sprite* background;
+
+#ifdef REWIND
+
+    RewindRing rewind;
+
+#endif
+
+    Particles particles;
+
+
+    // where startGame picks up from instead of a new game (a saved game or a rewind), NULL for a new game
+
+    const GameSnapshot* startFrom;
+
+
+    // touch to screen latency for this game, and the predictor that tries to hide it
+
+    LatencyStats latency;
+
+    TouchPredictor predictor;
+
+};
+
+
+GameSession session;
+
+
+// kept across games for the stats screen
+
+struct Records {
+
+    int gamesPlayed;
+
+    int highscore;
+
+};
+
+
+Records records;
+
+
+/*
+
+*   the game scene starting: a new game with the difficulty from the menu, which puts up the first item menu,
+
+*   or picking up from session.startFrom. then the scene loop runs the game a tick at a time (tickGame) until endGame
+
+*
+
+*   @author Ryan, Meenakshi, Agi
+
+*/
+
+void startGame() {
+
+    // picking up a game that was already going isn't another game played
+
+    if (session.startFrom == NULL) records.gamesPlayed++;
+
+
+    // load the background to be drawn on each frame
+
+    session.background = getSprite("BGFEH.pic");
+
+
+    // load every entity sprite both ways now, so no file gets read in the middle of the game loop
+
+    loadEntitySprites();
+
+
+    // everything about this session lives in state (score, player, items, enemies, attacks and all the timers)
+
+    session.state = GameState();
+
+    GameState& state = session.state;
+
+    state.hardMode = session.hardMode;
+
+
+    // set up the player, with lower health if in hard mode
+
+    state.player.transform = {150, 110, 0, 16, 32, 0, 0};
+
+    state.player.velocity = {0, 0, 1};
+
+    state.player.health = {20000};
+
+    state.player.sprite = {SPRITE_PLAYER_START};
+
+    state.player.animation = PLAYER_IDLE_ANIMATION;
+
+    if (state.hardMode) {
+
+        state.player.health.health = 15000;
+
+    }
+
+
+    // every waves count from the start of the game, unless they start right away
+
+    state.waveStartTime = TimeNowMSec();
+
+    for (int i = 0; i < waveScript.repeatingCount; i++) {
+
+        state.waveTimers[i] = waveScript.waves[waveScript.repeating[i]].now ? 0 : state.waveStartTime;
+
+    }
+
+
+    // seed the game's own random numbers so the whole session can be saved and replayed
+
+#ifdef BOT
+
+    gameRandom.seed(BOT_SEED);
+
+#else
+
+    gameRandom.seed(TimeNowMSec() * 65536 + Random.RandInt());
+
+#endif
+
+
+    // start recording events (and frames if capture is on) for this run
+
+    startCapture("captureFEH.bin");
+
+    startTelemetry("telemetryFEH.bin");
+
+    logTelemetry(TELEMETRY_GAME_START, state.hardMode, 0);
+
+
+    // rewind history, a snapshot goes in every REWIND_INTERVAL ticks
+
+#ifdef REWIND
+
+    session.rewind.clear();
+
+#endif
+
+
+    // hit, death and level up effects
+
+    session.particles.count = 0;
+
+    session.particles.numberCount = 0;
+
+
+    clearTouchPredictor(session.predictor);
+
+    clearLatencyStats(session.latency);
+
+
+    LCD.Clear();
+
+
+    // everything set up above gets replaced by where the game was, and it already has its items
+
+    if (session.startFrom != NULL) {
+
+        loadSnapshot(state, *session.startFrom);
+
+        session.startFrom = NULL;
+
+        return;
+
+    }
+
+
+    // prompt the user for first item
+
+    pushScene(SCENE_LEVEL_UP);
+
+}
+
+
+// the game in progress is kept here, so turning the Proteus off and back on picks it back up (see touchMainMenu)
+
+const char SAVE_FILE[] = "saveFEH.bin";
+
+
+// reads the saved game into the frame arena, NULL if there isn't one (or it's from a different version)
+
+const GameSnapshot* readSavedGame() {
+
+    // only called from menus, where nothing else is using the arena
+
+    resetFrameArena();
+
+    GameSnapshot* snapshot = frameNew<GameSnapshot>();
+
+    if (snapshot == NULL || !readSnapshotFile(SAVE_FILE, *snapshot)) return NULL;
+
+    return snapshot;
+
+}
+
+
+// saves the game in progress over the last save
+
+void saveGame() {
+
+    GameSnapshot* snapshot = frameNew<GameSnapshot>();
+
+    if (snapshot == NULL) return;
+
+    saveSnapshot(session.state, *snapshot);
+
+    writeSnapshotFile(SAVE_FILE, *snapshot);
+
+}
+
+
+// the game coming back on top after an item menu: the next level up's cards load in the background while playing,
+
+// and the menu was drawn straight on the LCD, so the whole frame has to go out again. it's also a good time to save,
+
+// since the player is between ticks with their new item
+
+void showGame() {
+
+    preloadItemCards(session.state.items);
+
+    invalidateScreen();
+
+    saveGame();
+
+}
+
+
+/*
+
+*   one tick of the game, with the touch screen as the scene loop just read it
+
+*
+
+*   @author Ryan, Meenakshi, Agi
+
+*/
+
+void tickGame(InputSample& input) {
+
+    // shorthands for the parts of the session used all over the tick
+
+    GameState& state = session.state;
+
+    Transform& player = state.player.transform;
+
+    Particles& particles = session.particles;
+
+    LatencyStats& latency = session.latency;
+
+    TouchPredictor& predictor = session.predictor;
+
+
+    state.tick++;
+
+    setTelemetryTick(state.tick);
+
+
+    // everything allocated last tick is done with, and after warming up nothing should need the heap
+
+    resetFrameArena();
+
+    setHeapCheck(state.tick > HEAP_CHECK_WARMUP);
+
+
+    // keep the rewind history going (the snapshot is too big for the stack on the Proteus, so it goes in the arena)
+
+#ifdef REWIND
+
+    if (state.tick % REWIND_INTERVAL == 0) {
+
+        GameSnapshot* snapshot = frameNew<GameSnapshot>();
+
+        if (snapshot != NULL) {
+
+            saveSnapshot(state, *snapshot);
+
+            pushSnapshot(session.rewind, *snapshot);
+
+        }
+
+    }
+
+#endif
+
+
+    // the bot plays instead of the touch screen
+
+#ifdef BOT
+
+    input.touching = botTouch(state, input.x, input.y);
+
+    input.time = TimeNowMSec();
+
+#endif
+
+    input.tick = state.tick;
+
+    addTouchSample(predictor, input);
+
+    bool inputMovedPlayer = false;
+
+
+    // if player is touching the screen
+
+    if (input.touching) {
+
+
+        // aim for where the finger will be when this frame is on screen, not where it was when read
+
+        float targetX, targetY;
+
+        predictTouch(predictor, input.time + latency.averageTouchToPresent, targetX, targetY);
+
+
+        // move the player to the touched point
+
+        Real oldX = player.x;
+
+        Real oldY = player.y;
+
+        seekSystem(&player, &state.player.velocity, 1, targetX - player.width/2, targetY - player.height/2);
+
+        moveSystem(&player, &state.player.velocity, 1);
+
+        inputMovedPlayer = player.x != oldX || player.y != oldY;
+
+
+        // update the direction the player is facing, the sprite gets flipped if facing left
+
+        state.playerFacingRight = (player.angle > -M_PI_2 && player.angle < M_PI_2);
+
+        player.mirrored = !state.playerFacingRight;
+
+
+        // alternate between walk and default sprite
+
+        playAnimation(state.player.animation, PLAYER_WALK_ANIMATION);
+
+    } else { // back to the not walking one if not walking
+
+        playAnimation(state.player.animation, PLAYER_IDLE_ANIMATION);
+
+    }
+
+
+    // spawn whatever the wave script says is due
+
+    waveSystem(state, waveScript);
+
+
+
+    // handle attacks when player has the marble weapon
+
+    if (state.items.marble.level > -1) {
+
+
+        // if time to spawn marble attack
+
+        if (TimeNowMSec() - state.marbleTimer > (unsigned long)state.items.marble.cooldown[state.items.marble.level]) {
+
+            // resets marble cooldown
+
+            state.marbleTimer = TimeNowMSec();
+
+
+            // makes 8 of them in 45 degree increments, fired as one batch
+
+            AttackSpawn ring[8];
+
+            for (int i = 0; i < 8; i++) {
+
+                ring[i] = {player.x + player.width/2, player.y + player.height/2, 4, 4, 1, 2*MARBLE_DIRECTIONS[i][0], 2*MARBLE_DIRECTIONS[i][1], state.items.marble.damage[state.items.marble.level], ITEM_MARBLE, SPRITE_MARBLE};
+
+            }
+
+            addAttacks(state.attacks, ring, 8, state.tick);
+
+        }
+
+    }
+
+
+    // handle attacks when player has the airfoil weapon
+
+    if (state.items.airfoil.level > -1) {
+
+
+        // updates player movespeed bonus from the item
+
+        state.player.velocity.speed = 1 + state.items.airfoil.moveBonus[state.items.airfoil.level];
+
+
+        // if time to spawn airfoil attack
+
+        if (TimeNowMSec() - state.airfoilTimer > (unsigned long)state.items.airfoil.cooldown[state.items.airfoil.level]) {
+
+            // resets airfoil cooldown
+
+            state.airfoilTimer = TimeNowMSec();
+
+
+            // creates attack going opposite the player angle so it shoots backwards
+
+            addAttack(state.attacks, player.x + player.width/2, player.y + player.height/2, 6, 6, 8, Real(-2.5)*realCos(player.angle), Real(-2.5)*realSin(player.angle), state.items.airfoil.damage[state.items.airfoil.level], ITEM_AIRFOIL, state.tick, SPRITE_AIRFOIL);
+
+        }
+
+    }
+
+
+    // handle attacks when player has the circuit weapon
+
+    if (state.items.circuit.level > -1) {
+
+
+        // if time to spawn the circuit attack
+
+        if (TimeNowMSec() - state.circuitTimer > (unsigned long)state.items.circuit.cooldown[state.items.circuit.level]) {
+
+            // resets circuit cooldown
+
+            state.circuitTimer = TimeNowMSec();
+
+
+            // creates circuit attack with 0 speed
+
+            addAttack(state.attacks, player.x + player.width/2, player.y + player.height/2, 6, 4, state.items.circuit.hits[state.items.circuit.level], 0, 0, state.items.circuit.damage[state.items.circuit.level], ITEM_CIRCUIT, state.tick, SPRITE_CIRCUIT);
+
+        }
+
+    }
+
+
+    // run the systems, always in this order
+
+    pathSystem(state.attacks, state.tick);
+
+    seekSystem(state.enemies.transform, state.enemies.velocity, state.enemies.count, player.x, player.y);
+
+    moveSystem(state.enemies.transform, state.enemies.velocity, state.enemies.count);
+
+    bool gameOver = contactSystem(state);
+
+    cooldownSystem(state.enemies.cooldown, state.enemies.count);
+
+    beamHitSystem(state, particles);
+
+    attackHitSystem(state, particles);
+
+    enemyDeathSystem(state, particles);
+
+    attackDeathSystem(state.attacks);
+
+
+    // if the player has enough xp to level up
+
+    if (state.xpToNextLevel - state.player.xp <= 0) {
+
+
+        // reset the player xp and increments level
+
+        state.player.xp = 0;
+
+        state.player.level++;
+
+        logTelemetry(TELEMETRY_LEVEL_UP, state.player.level, state.score);
+
+
+        // level up burst around the player
+
+        emitParticles(particles, (float)player.x + player.width/2, (float)player.y + player.height/2, 64, 3, 45, GOLD);
+
+
+        // only prompt new items if there are new items to give
+
+        if (state.player.level < 15) {
+
+            // menus aren't steady-state frames. the menu goes up over this frame once the tick is done
+
+            setHeapCheck(false);
+
+            pushScene(SCENE_LEVEL_UP);
+
+        }
+
+
+        // update xp requirement (the wave script makes enemies spawn more frequently)
+
+        state.xpToNextLevel = 5 + 5*state.player.level;
+
+
+        // update score
+
+        state.score += 100;
+
+    }
+
+
+    // start the frame with the background (the frame only goes to the LCD once everything is drawn, so no flickering)
+
+    drawSpriteCommand(drawList, LAYER_BACKGROUND, spriteHandle(session.background), 0, 0);
+
+
+    // handle attacks when player has the beam weapon (it isn't in the attack arrays, so it has its own layer)
+
+    if (state.items.beam.level > -1) {
+
+        // temp variables for the center of the player (drawing only, so plain floats are fine)
+
+        float centerX = (float)player.x + player.width/2;
+
+        float centerY = (float)player.y + player.height/2;
+
+        float angle = (float)player.angle;
+
+
+        // color of the beam based on item level
+
+        unsigned int beamColor = state.items.beam.color[state.items.beam.level];
+
+
+        // temp variables for the end of the beam, calculated based on level
+
+        float beamX = state.items.beam.length[state.items.beam.level]*cos(angle);
+
+        float beamY = state.items.beam.length[state.items.beam.level]*sin(angle);
+
+
+        // draw the beam
+
+        // conditional rendering if the angle is near vertical to prevent weird artifacting with vertical lines
+
+        if (sin(angle) > 0.99) {
+
+            drawLineCommand(drawList, LAYER_BEAM, centerX, centerY, centerX, centerY + state.items.beam.length[state.items.beam.level], beamColor);
+
+        } else if (sin(angle) < -0.99) {
+
+            drawLineCommand(drawList, LAYER_BEAM, centerX, centerY, centerX, centerY - state.items.beam.length[state.items.beam.level], beamColor);
+
+        } else {
+
+            drawLineCommand(drawList, LAYER_BEAM, centerX, centerY, centerX + beamX, centerY + beamY, beamColor);
+
+        }
+
+    }
+
+
+    // enemies, then attacks, then the player on top (the layers keep that order)
+
+    facingSystem(state.enemies.transform, state.enemies.count);
+
+    animationSystem(state.enemies.animation, state.enemies.sprite, state.enemies.count);
+
+    animationSystem(&state.player.animation, &state.player.sprite, 1);
+
+    renderSystem(drawList, LAYER_ENEMIES, state.enemies.transform, state.enemies.sprite, state.enemies.count);
+
+    hitFlashSystem(drawList, state.enemies.transform, state.enemies.cooldown, state.enemies.count);
+
+    renderSystem(drawList, LAYER_ATTACKS, state.attacks.transform, state.attacks.sprite, state.attacks.count);
+
+    renderSystem(drawList, LAYER_PLAYER, &player, &state.player.sprite, 1);
+
+
+    // draw everything added above, sorted by layer and sprite
+
+    drawDrawList(drawList);
+
+
+    // move and draw the effects on top of everything else
+
+    updateParticles(particles);
+
+    drawParticles(particles);
+
+
+    // send the finished frame to the LCD (and the capture file)
+
+    presentFrame();
+
+    captureFrame();
+
+    recordPresent(latency, input, state.tick, inputMovedPlayer);
+
+
+    // display health and xp to level up. text goes straight to the LCD on top of the frame,
+
+    // so that area gets marked to be painted over next frame
+
+    LCD.SetFontColor(WHITE);
+
+    LCD.WriteAt("Health: ", 0, 0);
+
+    LCD.WriteAt(state.player.health.health, 8*CHAR_WIDTH, 0);
+
+    // if max level, show "Max!" for xp
+
+    LCD.WriteAt("XP To Lvl Up: ", 0, CHAR_HEIGHT);
+
+    if (state.player.level < 15) {
+
+        LCD.WriteAt(state.xpToNextLevel - state.player.xp, 14*CHAR_WIDTH, CHAR_HEIGHT);
+
+    } else {
+
+        LCD.WriteAt("Max!", 14*CHAR_WIDTH, CHAR_HEIGHT);
+
+    }
+
+    LCD.WriteAt("Score: ", 0, 2*CHAR_HEIGHT);
+
+    LCD.WriteAt(state.score, 7*CHAR_WIDTH, 2*CHAR_HEIGHT);
+
+    invalidateRectangle(0, 0, 20*CHAR_WIDTH, 3*CHAR_HEIGHT);
+
+
+    drawDamageNumbers(particles);
+
+    drawLatencyOverlay(latency);
+
+
+    if (gameOver) endGame();
+
+}
+
+
+/*
+
+*   the game is over: finish recording, keep the high score, and swap the game for the game over screen
+
+*   (along with an item menu from the last tick, if there is one)
+
+*
+
+*   @author Ryan, Meenakshi, Agi
+
+*/
+
+void endGame() {
+
+    // the game is over, so back to allowing the heap
+
+    setHeapCheck(false);
+
+
+    // finish recording this run
+
+    flushPlayerHurt();
+
+    logTelemetry(TELEMETRY_GAME_OVER, 0, session.state.score);
+
+    stopTelemetry();
+
+    stopCapture();
+
+    writeLatencyLog("latencyFEH.txt", session.latency);
+
+
+    if (records.highscore < session.state.score) records.highscore = session.state.score;
+
+
+    // nothing to pick back up anymore
+
+    remove(SAVE_FILE);
+
+
+    while (topScene().type != SCENE_GAME) popScene();
+
+    replaceScene(SCENE_GAME_OVER);
+
+}
+
+
+#ifdef REWIND
+
+// how far back the game over screen's rewind button goes
+
+const int REWIND_SECONDS = 5;
+
+
+FEHIcon::Icon rewindButton[1];
+
+
+/*
+
+*   goes back REWIND_SECONDS from where the game ended (or as far as the history goes) and plays on from there.
+
+*   returns false if there's no history at all
+
+*/
+
+bool rewindGame() {
+
+    int stepsBack = REWIND_SECONDS * 60 / REWIND_INTERVAL;
+
+    if (stepsBack >= session.rewind.count) stepsBack = session.rewind.count - 1;
+
+
+    // only called from the game over screen, where nothing else is using the arena
+
+    resetFrameArena();
+
+    GameSnapshot* snapshot = frameNew<GameSnapshot>();
+
+    if (snapshot == NULL || !rewindSnapshot(session.rewind, stepsBack, *snapshot)) return false;
+
+
+    session.startFrom = snapshot;
+
+    replaceScene(SCENE_GAME);
+
+    return true;
+
+}
+
+#endif
+
+
+// displays session score. the bot doesn't wait for a tap, it prints it and starts the next game until it has played them all
+
+void showGameOver() {
+
+    LCD.Clear();
+
+    LCD.WriteAt("Your Score: ", 50, 60);
+
+    LCD.WriteAt(session.state.score, 100, 80);
+
+
+#ifdef REWIND
+
+    char labels[1][20] = {"REWIND"};
+
+    FEHIcon::DrawIconArray(rewindButton, 1, 1, 170, 10, 100, 100, labels, RED, GOLD);
+
+#endif
+
+
+#ifdef BOT
+
+    printf("bot game %d score %d\n", records.gamesPlayed, session.state.score);
+
+    popScene();
+
+    if (records.gamesPlayed < BOT_GAMES) pushScene(SCENE_DIFFICULTY);
+
+#endif
+
+}
+
+
+// a tap anywhere goes back to the main menu, except on the rewind button
+
+void touchGameOver(int event, float x, float y) {
+
+#ifdef REWIND
+
+    if (event == TOUCH_DOWN && rewindButton[0].Pressed(x, y, 0) && rewindGame()) return;
+
+#else
+
+    (void)x;
+
+    (void)y;
+
+#endif
+
+    if (event == TOUCH_UP) popScene();
+
+}
+
+
+#ifdef BENCHMARK
+
+// enemies and attacks start at CAPACITY_START and go up by a quarter a step, until p99 of a step's frame times
+
+// is over the budget (60 fps)
+
+const int CAPACITY_START = 64;
+
+const float CAPACITY_BUDGET_MS = 16.7;
+
+// each step settles for CAPACITY_WARMUP_TICKS, then CAPACITY_TICKS frames are timed
+
+const int CAPACITY_WARMUP_TICKS = 60;
+
+const int CAPACITY_TICKS = 600;
+
+const unsigned int CAPACITY_SEED = 12345;
+
+// every enemy touching the player hurts it every tick, so this is put back before each one
+
+const int CAPACITY_PLAYER_HEALTH = 1000000;
+
+
+// turns a -D value that isn't quoted (like -DBUILD_REV=$(git rev-parse --short HEAD)) into a string
+
+#define CAPACITY_STRING(value) #value
+
+#define CAPACITY_VALUE(value) CAPACITY_STRING(value)
+
+
+/*
+
+*   what this was built from and how, so results from different builds can be told apart: the revision passed in
+
+*   as BUILD_REV, the compiler, the flags passed in as BUILD_FLAGS (the compiler can't tell what it was given,
+
+*   so otherwise just the ones that show up as macros) and the optional features
+
+*/
+
+const char CAPACITY_BUILD[] = "built " __DATE__ " " __TIME__
+
+#ifdef BUILD_REV
+
+    " rev " CAPACITY_VALUE(BUILD_REV)
+
+#else
+
+    " rev unknown"
+
+#endif
+
+#ifdef __VERSION__
+
+    " compiler " __VERSION__
+
+#endif
+
+#ifdef BUILD_FLAGS
+
+    " flags " CAPACITY_VALUE(BUILD_FLAGS)
+
+#else
+
+#ifdef __OPTIMIZE_SIZE__
+
+    " -Os"
+
+#elif defined(__OPTIMIZE__)
+
+    " -O"
+
+#else
+
+    " -O0"
+
+#endif
+
+#ifdef __FAST_MATH__
+
+    " -ffast-math"
+
+#endif
+
+#ifdef NDEBUG
+
+    " -DNDEBUG"
+
+#endif
+
+#endif
+
+#ifdef FIXED_POINT_PHYSICS
+
+    " FIXED_POINT_PHYSICS"
+
+#endif
+
+#ifdef INDEXED_COLOR
+
+    " INDEXED_COLOR"
+
+#endif
+
+#ifdef TELEMETRY
+
+    " TELEMETRY"
+
+#endif
+
+#ifdef CAPTURE
+
+    " CAPTURE"
+
+#endif
+
+#ifdef HEAP_CHECK
+
+    " HEAP_CHECK"
+
+#endif
+
+#if defined(__AVX2__)
+
+    " AVX2"
+
+#elif defined(__SSE2__)
+
+    " SSE2"
+
+#endif
+
+    ;
+
+
+// frame times for the capacity benchmark in 0.1 ms buckets, enough to tell frames near the budget apart. a step
+
+// that gets far slower than the budget ends the benchmark, so past 100 ms only the slowest frame is kept
+
+const int FRAME_TIME_BUCKETS = 1000;
+
+
+struct FrameTimeHistogram {
+
+    unsigned int count[FRAME_TIME_BUCKETS + 1]; // the last bucket is everything 100 ms and over
+
+    unsigned int total;
+
+    unsigned long slowest; // tenths of a ms
+
+};
+
+
+void addFrameTime(FrameTimeHistogram& histogram, unsigned long tenths) {
+
+    histogram.count[tenths < (unsigned long)FRAME_TIME_BUCKETS ? tenths : FRAME_TIME_BUCKETS]++;
+
+    histogram.total++;
+
+    if (tenths > histogram.slowest) histogram.slowest = tenths;
+
+}
+
+
+// the smallest frame time that percent of the frames are at or under, in tenths of a ms. if that lands in the last
+
+// bucket it's the slowest frame, so it's never less than the real one
+
+unsigned long frameTimePercentile(const FrameTimeHistogram& histogram, int percent) {
+
+    if (histogram.total == 0) return 0;
+
+
+    unsigned long needed = ((unsigned long)histogram.total * percent + 99) / 100;
+
+    unsigned long seen = 0;
+
+    for (int i = 0; i < FRAME_TIME_BUCKETS; i++) {
+
+        seen += histogram.count[i];
+
+        if (seen >= needed) return i;
+
+    }
+
+    return histogram.slowest;
+
+}
+
+
+/*
+
+*   keeps count enemies and count attacks alive: whatever died last tick is replaced, enemies at the edges
+
+*   like the waves spawn them and attacks as marbles flying out from the player in every direction
+
+*/
+
+void fillCapacity(GameState& state, int count) {
+
+    const Transform& player = state.player.transform;
+
+    while (state.enemies.count < count && waveScript.enemyCount > 0) {
+
+        spawnEnemy(state.enemies, waveScript.enemies[0], state.player.level, 1);
+
+    }
+
+    while (state.attacks.count < count) {
+
+        const float* direction = MARBLE_DIRECTIONS[gameRandom.randInt() % 8];
+
+        Real speed = Real(1 + gameRandom.randInt() % 3);
+
+        addAttack(state.attacks, player.x + player.width/2, player.y + player.height/2, 4, 4, 1, speed*direction[0], speed*direction[1],
+
+                  state.items.marble.damage[MAX_ITEM_LEVEL], ITEM_MARBLE, state.tick, SPRITE_MARBLE);
+
+    }
+
+}
+
+
+/*
+
+*   the most enemies and attacks a build can handle at 60 fps. starts a late game (every item maxed, past the last
+
+*   level up, no waves), then ramps the counts up a step at a time and times every tick of it, including drawing and
+
+*   presenting the frame. prints each step's frame times and appends the ceiling to capacityFEH.txt, one line per run
+
+*/
+
+void benchmarkCapacity() {
+
+    // the waves would only add more on top of the counts being tested
+
+    WaveScript waves = waveScript;
+
+    waveScript.repeatingCount = 0;
+
+    waveScript.levelWaveCount = 0;
+
+    waveScript.scheduleCount = 0;
+
+
+    // a game with the level up menu it opens on taken away again
+
+    session.hardMode = false;
+
+    pushScene(SCENE_GAME);
+
+    if (topScene().type == SCENE_LEVEL_UP) popScene();
+
+
+    GameState& state = session.state;
+
+    gameRandom.seed(CAPACITY_SEED);
+
+    state.player.level = 15;
+
+    state.xpToNextLevel = 5 + 5*state.player.level;
+
+    state.items.marble.level = MAX_ITEM_LEVEL;
+
+    state.items.airfoil.level = MAX_ITEM_LEVEL;
+
+    state.items.beam.level = MAX_ITEM_LEVEL;
+
+    state.items.circuit.level = MAX_ITEM_LEVEL;
+
+    state.items.report.level = MAX_ITEM_LEVEL;
+
+
+    FrameTimeHistogram frameTimes;
+
+    InputSample input = {};
+
+    int ceiling = 0;
+
+    unsigned long ceilingP99 = 0;
+
+    int count;
+
+
+    for (count = CAPACITY_START; count <= MAX_ENEMIES && count <= MAX_ATTACKS; count += count / 4) {
+
+        memset(&frameTimes, 0, sizeof(frameTimes));
+
+
+        for (int i = 0; i < CAPACITY_WARMUP_TICKS + CAPACITY_TICKS; i++) {
+
+            // the player stands in the middle of it all and can't die
+
+            state.player.health.health = CAPACITY_PLAYER_HEALTH;
+
+            fillCapacity(state, count);
+
+
+            double start = TimeNow();
+
+            tickGame(input);
+
+            if (i >= CAPACITY_WARMUP_TICKS) addFrameTime(frameTimes, (unsigned long)((TimeNow() - start) * 10000));
+
+        }
+
+
+        // printing can allocate, and this isn't a frame
+
+        setHeapCheck(false);
+
+        unsigned long p50 = frameTimePercentile(frameTimes, 50);
+
+        unsigned long p99 = frameTimePercentile(frameTimes, 99);
+
+        printf("capacity %d enemies %d attacks: p50 %.1f ms, p99 %.1f ms\n", count, count, p50 / 10.0, p99 / 10.0);
+
+
+        if (p99 / 10.0 > CAPACITY_BUDGET_MS) break;
+
+        ceiling = count;
+
+        ceilingP99 = p99;
+
+    }
+
+
+    // never went over the budget, so the real ceiling is somewhere past the caps
+
+    bool capped = count > MAX_ENEMIES || count > MAX_ATTACKS;
+
+    printf("capacity: %d enemies and %d attacks at p99 %.1f ms%s\n", ceiling, ceiling, ceilingP99 / 10.0,
+
+           capped ? ", still under budget at MAX_ENEMIES/MAX_ATTACKS" : "");
+
+
+    FILE* log = fopen("capacityFEH.txt", "a");
+
+    if (log != NULL) {
+
+        fprintf(log, "%s: %d%s enemies and attacks, p99 %.1f ms\n", CAPACITY_BUILD, ceiling, capped ? "+" : "", ceilingP99 / 10.0);
+
+        fclose(log);
+
+    }
+
+
+    // put everything back the way the game expects it
+
+    setHeapCheck(false);
+
+    stopTelemetry();
+
+    stopCapture();
+
+    sceneStack.count = 0;
+
+    waveScript = waves;
+
+}
+
+#endif
+
+
+/*
+
+*   adds an enemy with scaling parameters based on player level (if there is room).
+
+*   also increases health if on hardMode, and increases stats if its a boss enemy
+
+*
+
+*   @author Ryan
+
+*/
+
+void spawnEnemy(EnemyArchetype& enemies, const WaveEnemy& archetype, int level, float healthModifier) {
+
+    int enemyWidth = 14;
+
+    int enemyHeight = 32;
+
+
+    // stats from the wave script, scaling with level
+
+    int enemyHealth = (archetype.health + archetype.healthPerLevel*level) * healthModifier;
+
+    Real enemySpeed = Real(archetype.speed) + Real(archetype.speedPerLevel)*level;
+
+    int enemyDamage = archetype.damage + archetype.damagePerLevel*level;
+
+
+    Real spawnX, spawnY;
+
+
+    // randomly pick if enemy should be spawned on n/e/s/w wall
+
+    // RandInt / 32767 is random number between 0 and 1 (done as Real so fixed point mode stays exact)
+
+    if (gameRandom.randInt() % 2 == 0) {
+
+        if (gameRandom.randInt() % 2 == 0) {
+
+            spawnX = 0;
+
+            spawnY = (WINDOW_HEIGHT - enemyHeight) * (Real(gameRandom.randInt()) / 32767);
+
+        } else {
+
+            spawnX = WINDOW_WIDTH - enemyWidth;
+
+            spawnY = (WINDOW_HEIGHT - enemyHeight) * (Real(gameRandom.randInt()) / 32767);
+
+        }
+
+    } else {
+
+        if (gameRandom.randInt() % 2 == 0) {
+
+            spawnX = (WINDOW_WIDTH - enemyWidth) * (Real(gameRandom.randInt()) / 32767);
+
+            spawnY = 0;
+
+        } else {
+
+            spawnX = (WINDOW_WIDTH - enemyWidth) * (Real(gameRandom.randInt()) / 32767);
+
+            spawnY = WINDOW_HEIGHT - enemyHeight;
+
+        }
+
+    }
+
+
+    // randomly pick enemy sprite, rand is random value between 0 and 4
+
+    int rand = gameRandom.randInt() / 32768.0 * 5;
+
+
+    // enemy 3 sprite is thinner, so update enemyWidth
+
+    if (rand == 2) {
+
+        enemyWidth = 11;
+
+    }
+
+
+    // add the enemy
+
+    int type = archetype.boss ? ENEMY_BOSS_TYPE + rand : rand;
+
+    addEnemy(enemies, spawnX, spawnY, enemyWidth, enemyHeight, enemyHealth, enemySpeed, enemyDamage, type, SPRITE_ENEMY1 + rand);
+
+}
+
+
+
+/*
+
+*   difficulty menu. picking one starts the game in its place. the bot doesn't see it, it always plays BOT_HARD_MODE
+
+*
+
+*   @author Ryan
+
+*/
+
+FEHIcon::Icon difficultyMenu[2];
+
+
+void startDifficultyMenu() {
+
+    // the first item cards load while the difficulty is being picked
+
+    Items items;
+
+    preloadItemCards(items);
+
+
+#ifdef BOT
+
+    session.hardMode = BOT_HARD_MODE;
+
+    replaceScene(SCENE_GAME);
+
+#endif
+
+}
+
+
+void showDifficultyMenu() {
+
+    LCD.Clear();
+
+
+    // Set up and draw menu
+
+    char menuLabels[2][20] = {"NORMAL","HARD"};
+
+    FEHIcon::DrawIconArray(difficultyMenu, 1, 2, 10, 10, 5, 5, menuLabels, RED, GOLD);
+
+}
+
+
+// hard if pressed hard, normal if pressed normal
+
+void touchDifficultyMenu(float x, float y) {
+
+    if (difficultyMenu[0].Pressed(x, y, 0)) {
+
+        session.hardMode = false;
+
+        replaceScene(SCENE_GAME);
+
+    } else if (difficultyMenu[1].Pressed(x, y, 0)) {
+
+        session.hardMode = true;
+
+        replaceScene(SCENE_GAME);
+
+    }
+
+}
+
+
+/*
+
+*   loot table for the level up menu, sampled with Vose's alias method. every item that can still be offered gets
+
+*   one column, and a draw is one random column plus one random number to pick between the column's item and its alias,
+
+*   so it costs the same however many items are maxed out. it only gets rebuilt when item levels have changed
+
+*/
+
+struct LootTable {
+
+    int count; // items that can be offered
+
+    int total; // sum of their weights
+
+    int weights[ITEM_COUNT]; // by item id, what the table was built from
+
+    int items[ITEM_COUNT];
+
+    int alias[ITEM_COUNT]; // column to use instead when the draw lands past threshold
+
+    int threshold[ITEM_COUNT]; // out of total
+
+    int builtFor[ITEM_COUNT]; // item levels the table was built for
+
+};
+
+
+// how often each item gets offered compared to the others, by item id
+
+const int LOOT_ITEM_WEIGHTS[ITEM_COUNT] = {1, 1, 1, 1, 1};
+
+// rarity tiers, by the level the card would take the item to: common (first level), uncommon, rare (max level).
+
+// all the same for now, which offers every item that can be offered equally often like before
+
+const int LOOT_TIER_WEIGHTS[MAX_ITEM_LEVEL + 1] = {1, 1, 1};
+
+
+LootTable lootTable = {-1, 0, {}, {}, {}, {}, {}};
+
+
+/*
+
+*   how much an item weighs in the loot table right now, 0 if it can't be offered: maxed out items can't,
+
+*   and neither can the lab report as the first item because it does no damage
+
+*/
+
+int lootWeight(Items& items, int item) {
+
+    int level = *itemLevel(items, item);
+
+    if (level >= MAX_ITEM_LEVEL) return 0;
+
+
+    if (item == ITEM_REPORT && items.airfoil.level == -1 && items.beam.level == -1 && items.circuit.level == -1 && items.marble.level == -1) {
+
+        return 0;
+
+    }
+
+
+    return LOOT_ITEM_WEIGHTS[item] * LOOT_TIER_WEIGHTS[level + 1];
+
+}
+
+
+/*
+
+*   builds the alias table from the table's weights (Vose's method), items weighing 0 get no column. each column starts
+
+*   as its weight times the number of columns, columns under total get topped up from ones over total, which become their alias
+
+*/
+
+void buildLootTable(LootTable& table) {
+
+    int scaled[ITEM_COUNT];
+
+    table.count = 0;
+
+    table.total = 0;
+
+    for (int item = 0; item < ITEM_COUNT; item++) {
+
+        int weight = table.weights[item];
+
+        if (weight == 0) continue;
+
+
+        table.items[table.count] = item;
+
+        scaled[table.count] = weight;
+
+        table.total += weight;
+
+        table.count++;
+
+    }
+
+
+    int small[ITEM_COUNT], large[ITEM_COUNT];
+
+    int smallCount = 0, largeCount = 0;
+
+    for (int i = 0; i < table.count; i++) {
+
+        scaled[i] *= table.count;
+
+        if (scaled[i] < table.total) {
+
+            small[smallCount++] = i;
+
+        } else {
+
+            large[largeCount++] = i;
+
+        }
+
+    }
+
+
+    while (smallCount > 0 && largeCount > 0) {
+
+        int under = small[--smallCount];
+
+        int over = large[largeCount - 1];
+
+
+        table.threshold[under] = scaled[under];
+
+        table.alias[under] = over;
+
+
+        // the big column gives up what it took to fill the small one
+
+        scaled[over] -= table.total - scaled[under];
+
+        if (scaled[over] < table.total) {
+
+            largeCount--;
+
+            small[smallCount++] = over;
+
+        }
+
+    }
+
+
+    // whatever is left is full (or only off by rounding)
+
+    while (largeCount > 0) {
+
+        int column = large[--largeCount];
+
+        table.threshold[column] = table.total;
+
+        table.alias[column] = column;
+
+    }
+
+    while (smallCount > 0) {
+
+        int column = small[--smallCount];
+
+        table.threshold[column] = table.total;
+
+        table.alias[column] = column;
+
+    }
+
+}
+
+
+// draws one item from the table, weighted
+
+int drawLoot(const LootTable& table) {
+
+    int column = gameRandom.randInt() * table.count / 32768;
+
+    // keep the column's item with a chance of threshold / total
+
+    bool keep = (long long)gameRandom.randInt() * table.total < (long long)table.threshold[column] * 32768;
+
+    return table.items[keep ? column : table.alias[column]];
+
+}
+
+
+/*
+
+*   draws up to choiceCount different items from the table, fewer if it doesn't have that many. returns how many it drew.
+
+*   after each draw the item's weight is zeroed and the alias table is rebuilt over the items left (on a copy), so every
+
+*   draw takes exactly two random numbers and the others keep their weights relative to each other.
+
+*   the rebuild makes each draw O(n) rather than O(1), but n is ITEM_COUNT and this runs once per level up. drawing from
+
+*   the cached table and throwing away repeats would be O(1) a draw, but it takes as many random numbers as it has to,
+
+*   which can be a lot when one item has most of the weight, and that would change every replay after it
+
+*/
+
+int drawLootChoices(const LootTable& table, int choices[], int choiceCount) {
+
+    if (choiceCount > table.count) choiceCount = table.count;
+
+
+    LootTable remaining = table;
+
+    for (int i = 0; i < choiceCount; i++) {
+
+        choices[i] = drawLoot(remaining);
+
+        if (i == choiceCount - 1) break;
+
+
+        remaining.weights[choices[i]] = 0;
+
+        buildLootTable(remaining);
+
+    }
+
+    return choiceCount;
+
+}
+
+
+// picks up to choiceCount different items to offer for the current item levels, returns how many it picked
+
+int pickLoot(Items& items, int choices[], int choiceCount) {
+
+    // rebuild only if a level has changed since last time
+
+    bool changed = lootTable.count < 0;
+
+    for (int item = 0; item < ITEM_COUNT; item++) {
+
+        if (lootTable.builtFor[item] != *itemLevel(items, item)) changed = true;
+
+    }
+
+    if (changed) {
+
+        for (int item = 0; item < ITEM_COUNT; item++) {
+
+            lootTable.builtFor[item] = *itemLevel(items, item);
+
+            lootTable.weights[item] = lootWeight(items, item);
+
+        }
+
+        buildLootTable(lootTable);
+
+    }
+
+
+    return drawLootChoices(lootTable, choices, choiceCount);
+
+}
+
+
+/*
+
+*   level up menu for picking an item, which updates the game's items accordingly
+
+*
+
+*   @author Ryan, Meenakshi
+
+*/
+
+struct LevelUpMenu {
+
+    int choiceCount;
+
+    // item choice pointers and item sprite displays
+
+    int* itemChoices[3];
+
+    char itemImageNames[3][30];
+
+};
+
+
+LevelUpMenu levelUp;
+
+
+// where each card goes across the menu
+
+const int LEVEL_UP_CARD_X[3] = {20, 114, 208};
+
+
+void startLevelUp() {
+
+    Items& items = session.state.items;
+
+
+    // pick three different items from the loot table (fewer once most of them are maxed out)
+
+    int choices[3];
+
+    levelUp.choiceCount = pickLoot(items, choices, 3);
+
+    if (levelUp.choiceCount == 0) {
+
+        popScene();
+
+        return;
+
+    }
+
+
+    for (int i = 0; i < levelUp.choiceCount; i++) {
+
+        // set itemChoices to the proper item so we know which item level to increment if chosen
+
+        levelUp.itemChoices[i] = itemLevel(items, choices[i]);
+
+        // based on the current level, displays the proper sprite for upgrade text
+
+        itemCardName(items, choices[i], levelUp.itemImageNames[i]);
+
+    }
+
+
+#ifdef BOT
+
+    // the bot doesn't need to see the menu, it just takes its favorite of the three
+
+    int best = 0;
+
+    for (int i = 1; i < levelUp.choiceCount; i++) {
+
+        if (botItemRank(itemFromChoice(items, levelUp.itemChoices[i])) < botItemRank(itemFromChoice(items, levelUp.itemChoices[best]))) best = i;
+
+    }
+
+    (*levelUp.itemChoices[best])++;
+
+    logItemPick(items, levelUp.itemChoices[best]);
+
+    popScene();
+
+#endif
+
+}
+
+
+void showLevelUp() {
+
+    // draw the menu
+
+    LCD.SetFontColor(DARKGRAY);
+
+    LCD.FillRectangle(14, 14, WINDOW_WIDTH - 28, WINDOW_HEIGHT - 28);
+
+    LCD.SetFontColor(BLACK);
+
+    LCD.WriteAt("Level Up!", 105, 20);
 
-        player.drawSelf();
 
+    // draw the proper sprites as selected above, one card per choice
 
-        // display health and xp to level up
+    for (int i = 0; i < levelUp.choiceCount; i++) {
 
-        LCD.SetFontColor(WHITE);
+        LCD.DrawRectangle(LEVEL_UP_CARD_X[i], 40, 90, 180);
 
-        LCD.Write("Health: ");
+        drawSpriteToLCD(getSprite(levelUp.itemImageNames[i]), LEVEL_UP_CARD_X[i], 40);
 
-        LCD.WriteLine(player.getHealth());
+    }
 
-        // if max level, show "Max!" for xp
 
-        LCD.Write("XP To Lvl Up: ");
+    LCD.Update();
 
-        if (player.getLevel() < 15) {
+}
 
-            LCD.WriteLine(xpToNextLevel - player.getXp());
 
-        } else {
+// updates the level of the picked item and goes back to the game
 
-            LCD.WriteLine("Max!");
+void touchLevelUp(float x, float y) {
 
-        }
+    if (y <= 40 || y >= 220) return;
 
-        LCD.Write("Score: ");
 
-        LCD.WriteLine(score);
+    for (int i = 0; i < levelUp.choiceCount; i++) {
 
-    }
+        if (x > LEVEL_UP_CARD_X[i] && x < LEVEL_UP_CARD_X[i] + 90) {
 
+            (*levelUp.itemChoices[i])++;
 
-    // close background image
+            logItemPick(session.state.items, levelUp.itemChoices[i]);
 
-    background.Close();
+            popScene();
 
+            return;
 
-    // display session score
+        }
 
-    LCD.Clear();
+    }
+
+}
 
-    LCD.WriteAt("Your Score: ", 50, 60);
 
-    LCD.WriteAt(score, 100, 80);
+// records which item was picked from the level up menu (itemChoice points at the level that was just raised)
+
+void logItemPick(Items& items, int* itemChoice) {
+
+    logTelemetry(TELEMETRY_ITEM_PICKED, itemFromChoice(items, itemChoice), *itemChoice);
+
+}
 
 
-    // wait for player to let go, then touch screen, then let go again
+// turns one of the level up menu's item level pointers back into which item it is
 
-    while (LCD.Touch(&xTouch, &yTouch));
+int itemFromChoice(Items& items, int* itemChoice) {
 
-    while (!LCD.Touch(&xTouch, &yTouch));
+    if (itemChoice == &items.marble.level) return ITEM_MARBLE;
 
-    while (LCD.Touch(&xTouch, &yTouch));
+    if (itemChoice == &items.airfoil.level) return ITEM_AIRFOIL;
 
+    if (itemChoice == &items.beam.level) return ITEM_BEAM;
 
-    return score;
+    if (itemChoice == &items.circuit.level) return ITEM_CIRCUIT;
 
+    return ITEM_REPORT;
 
 }
 
 
 /*
 
-*   creates an enemy with scaling parameters based on player level.
+*   removes an object from an array by moving everything above it down 1.
 
-*   also increases health if on hardMode, and increases stats if its a boss enemy
+*   uses template type T so the method can be used for any object type
 
 *
 
@@ -1350,719 +8442,855 @@ int game() {
 
 */
 
-Enemy createEnemy(int level, bool hardMode, bool boss) {
+template <class T>
 
-    int enemyWidth = 14;
+void removeFromArray(T array[], int arraySize, int indexToRemove) {
 
-    int enemyHeight = 32;
+    // moves everything above the thing to remove the the array down by 1
 
+    for (int i = indexToRemove; i < arraySize - 1; i++) {
+
+        array[i] = array[i + 1];
+
+    }
+
+}
 
-    // if hardmode, make the health modifier higher
 
-    float healthModifier = 1;
+#ifdef SELF_TEST
 
-    if (hardMode) {
+// how many checks have failed so far
 
-        healthModifier = 1.3;
+int selfCheckFailures = 0;
 
-    }
 
+// checks a condition, printing it with its line number if it's false
 
-    // initialize default values, scaling with player level
+#define CHECK(condition) selfCheck(condition, #condition, __LINE__)
 
-    int enemyHealth = (level + 1) * healthModifier;
 
-    float enemySpeed = 0.4 + 0.04*level;
+void selfCheck(bool ok, const char what[], int line) {
 
-    int enemyDamage = 5 + level;
+    if (ok) return;
 
+    printf("line %d: check failed: %s\n", line, what);
 
-    if (boss) { // if boss enemy then overwrite values
+    selfCheckFailures++;
 
-        enemyHealth = (2*level + 4) * healthModifier;
+}
+
+
+/*
+
+*   a sprite with see-through edges, a hole and a row that is all see-through goes into runs and comes back out the same,
+
+*   and the size asked for with NULL is the size written
+
+*/
 
-        enemySpeed = 0.2 + 0.02*level;
+void checkSpriteRuns() {
 
-        enemyDamage = 10 + level*2;
+    const unsigned int X = SEE_THROUGH;
+
+    const int width = 5, height = 4;
+
+    const unsigned int pixels[width * height] = {
+
+        X, 1, 2, X, X,
+
+        3, X, 4, 5, 6,
+
+        X, X, X, X, X,
+
+        7, 8, 9, 10, 11
 
     };
 
 
-    float spawnX, spawnY;
+    unsigned int runs[64];
 
+    int words = encodeSpriteRuns(pixels, width, height, NULL);
 
-    // randomly pick if enemy should be spawned on n/e/s/w wall
+    CHECK(words == encodeSpriteRuns(pixels, width, height, runs));
 
-    // RandInt / 32767.0 is random float between 0 and 1
+    // 4 row counts, 4 run words and 11 colors
 
-    if (Random.RandInt() % 2 == 0) {
+    CHECK(words == 19);
 
-        if (Random.RandInt() % 2 == 0) {
 
-            spawnX = 0;
+    unsigned int decoded[width * height];
 
-            spawnY = (WINDOW_HEIGHT - enemyHeight) * (Random.RandInt() / 32767.0);
+    for (int i = 0; i < width * height; i++) {
 
-        } else {
+        decoded[i] = X;
 
-            spawnX = WINDOW_WIDTH - enemyWidth;
+    }
 
-            spawnY = (WINDOW_HEIGHT - enemyHeight) * (Random.RandInt() / 32767.0);
+    const unsigned int* word = runs;
 
-        }
+    for (int row = 0; row < height; row++) {
 
-    } else {
+        int count = *word++;
 
-        if (Random.RandInt() % 2 == 0) {
+        for (int run = 0; run < count; run++) {
 
-            spawnX = (WINDOW_WIDTH - enemyWidth) * (Random.RandInt() / 32767.0);
+            int start = *word & 0xFFFF;
 
-            spawnY = 0;
+            int length = *word >> 16;
 
-        } else {
+            word++;
 
-            spawnX = (WINDOW_WIDTH - enemyWidth) * (Random.RandInt() / 32767.0);
+            for (int i = 0; i < length; i++) {
 
-            spawnY = WINDOW_HEIGHT - enemyHeight;
+                decoded[row * width + start + i] = *word++;
+
+            }
 
         }
 
     }
 
+    CHECK(word - runs == words);
 
-    // randomly pick enemy sprite, rand is random value between 0 and 4
+    CHECK(memcmp(decoded, pixels, sizeof(pixels)) == 0);
 
-    int rand = Random.RandInt() / 32768.0 * 5;
+}
 
-    char spriteName[30];
 
-    switch (rand) {
+// a pack with one sprite passes, and one whose header, index or runs don't fit in the file doesn't
 
-        case 0:
+void checkAssetPackBounds() {
 
-            strcpy(spriteName, "Enemy1FEH.pic");
+    const unsigned int pixels[4] = {1, 2, SEE_THROUGH, 3};
 
-            break;
+    const int words = encodeSpriteRuns(pixels, 2, 2, NULL);
 
-        case 1:
 
-            strcpy(spriteName, "Enemy2FEH.pic");
+    unsigned int pack[32] = {};
 
-            break;
+    AssetPackHeader* header = (AssetPackHeader*)pack;
 
-        case 2:
+    AssetPackEntry* entry = (AssetPackEntry*)(pack + sizeof(AssetPackHeader) / 4);
 
-            // enemy 3 sprite is thinner, so update enemyWidth
+    memcpy(header->magic, ASSET_PACK_MAGIC, 4);
 
-            strcpy(spriteName, "Enemy3FEH.pic");
+    header->version = ASSET_PACK_VERSION;
 
-            enemyWidth = 11;
+    header->count = 1;
 
-            break;
+    *entry = {hashAssetName("TestFEH.pic"), (unsigned int)(sizeof(AssetPackHeader) + sizeof(AssetPackEntry)), 2, 2, words};
 
-        case 3:
+    encodeSpriteRuns(pixels, 2, 2, pack + entry->offset / 4);
 
-            strcpy(spriteName, "Enemy4FEH.pic");
 
-            break;
+    const unsigned char* data = (const unsigned char*)pack;
 
-        default:
+    long size = entry->offset + words * 4;
 
-            strcpy(spriteName, "Enemy5FEH.pic");
+    CHECK(checkAssetPack(data, size));
 
-            break;
+    // the runs are cut off
 
-    }
+    CHECK(!checkAssetPack(data, size - 4));
 
 
-    // create and return the enemy
+    entry->offset = 0xFFFFFFF0u;
 
-    Enemy e(spawnX, spawnY, enemyWidth, enemyHeight, enemyHealth, enemySpeed, enemyDamage, spriteName);
+    CHECK(!checkAssetPack(data, size));
 
-    return e;
+    entry->offset = sizeof(AssetPackHeader);
 
-}
+    CHECK(!checkAssetPack(data, size));
 
+    entry->offset = size - words * 4;
 
 
-/*
+    entry->words = 0x40000000;
 
-*   prompt menu for difficulty setting
+    CHECK(!checkAssetPack(data, size));
 
-*
+    entry->words = words;
 
-*   @author Ryan
 
-*/
+    header->count = 0x7FFFFFFF;
 
-bool promptDifficulty() {
+    CHECK(!checkAssetPack(data, size));
 
-    // Set up and draw menu
+    header->count = 1;
 
-    FEHIcon::Icon menu[2];
 
-    char menuLabels[2][20] = {"NORMAL","HARD"};
+    header->version = ASSET_PACK_VERSION + 1;
 
-    FEHIcon::DrawIconArray(menu, 1, 2, 10, 10, 5, 5, menuLabels, RED, GOLD);
+    CHECK(!checkAssetPack(data, size));
 
+    header->version = ASSET_PACK_VERSION;
 
-    // keep track of touch locations
+    CHECK(checkAssetPack(data, size));
 
-    float x, y;
+}
 
 
-    // makes it so if you were holding the screen before it waits for you to let go first
+// every kind of wave line compiles into the right lists, and a line that doesn't make sense is caught with its number
 
-    while (LCD.Touch(&x, &y)) {}
+void checkWaveScript() {
 
+    const char text[] =
 
-    // returns true if pressed hard, and false if pressed normal
+        "enemy grunt health 1 1 speed 0.4 0.04 damage 5 1\n"
 
-    while (true) {
+        "enemy boss health 4 2 speed 0.2 0.02 damage 10 2 boss\n"
 
-        if (LCD.Touch(&x, &y)) {
+        "# a comment\n"
 
-            if (menu[0].Pressed(x, y, 0)) {
+        "hard 1.5\n"
 
-                return false;
+        "every 4000 faster 200 min 1000 spawn 1 grunt now\n"
 
-            }
+        "on 5 spawn 1 boss\n"
 
-            if (menu[1].Pressed(x, y, 0)) {
+        "on 2 spawn 2 grunt\n"
 
-                return true;
+        "at 9000 spawn 1 boss\n"
 
-            }
+        "at 1000 spawn 4 grunt over 4000\n";
 
-        }
 
-    }
+    WaveScript script = WaveScript();
 
-}
+    int line;
 
+    CHECK(parseWaveScript(script, text, line));
 
-/*
+    CHECK(script.enemyCount == 2);
 
-*   prompt menu for picking an item and updates items struct accordingly
+    CHECK(script.enemies[1].boss && !script.enemies[0].boss);
 
-*
+    CHECK(script.hardHealth == 1.5f);
 
-*   @author Ryan, Meenakshi
+    CHECK(script.repeatingCount == 1);
 
-*/
+    CHECK(script.waves[script.repeating[0]].now && script.waves[script.repeating[0]].minInterval == 1000);
 
-void promptItemMenu(Items &items) {
 
+    // on waves lowest level first
 
-    // declare item choice pointers and item sprite displays
+    CHECK(script.levelWaveCount == 2);
 
-    int* itemChoices[3];
+    CHECK(script.waves[script.levelWaves[0]].time == 2 && script.waves[script.levelWaves[1]].time == 5);
 
-    char itemImageNames[3][20];
 
+    // one spawn per enemy of the at waves, the spread out ones 1 second apart and all in time order
 
-    // for each of the three options
+    CHECK(script.scheduleCount == 5);
 
-    for (int i = 0; i < 3; i++) {
+    const unsigned int times[5] = {1000, 2000, 3000, 4000, 9000};
 
+    for (int i = 0; i < script.scheduleCount && i < 5; i++) {
 
-        // will keep looping until it randomly picks a valid option
+        CHECK(script.schedule[i].time == times[i]);
+
+    }
 
-        bool selected = false;
 
-        while (!selected) {
+    CHECK(!parseWaveScript(script, "enemy grunt health 1 1 speed 0.4 0.04 damage 5 1\nevery 4000 spawn 1 ghost\n", line));
 
-            // random int between 0 and 4
+    CHECK(line == 2);
 
-            int rand = Random.RandInt()/32768.0 * 5;
+    CHECK(!parseWaveScript(script, "at 1000 spawn 1\n", line));
 
-            switch (rand) {
+    CHECK(!parseWaveScript(script, "enemy grunt health 1 1 speed 0.4 0.04 damage 5 1\nat 0 spawn -1 grunt\n", line));
 
-                case 0:
+    // two waves that are fine on their own but together schedule more than MAX_SCHEDULED_SPAWNS
 
-                    // based on the current level, displays the proper sprite for upgrade text
+    CHECK(!parseWaveScript(script, "enemy grunt health 1 1 speed 0.4 0.04 damage 5 1\nat 0 spawn 60000 grunt\n"
 
-                    switch (items.airfoil.level) {
+                                   "at 0 spawn 60000 grunt\n", line));
 
-                        case -1:
+    CHECK(line == 3);
 
-                            // sets the item image to the proper sprite
 
-                            strcpy(itemImageNames[i], "airfoilItem1FEH.pic");
+    delete[] script.schedule;
+
+}
 
-                            // set itemChoices to the proper item so we know which item level to increment if chosen
 
-                            itemChoices[i] = &items.airfoil.level;
+// Fixed math stays in range, and attacks that barely move on one axis don't expire the tick they're fired
 
-                            // break out of the loop, something valid was chosen
+void checkFixedPoint() {
 
-                            selected = true;
+    CHECK((int)(Real(3) * Real(0.5)) == 1);
 
-                            break;
+    CHECK((int)(Real(-7) / Real(2)) == -3);
 
-                        case 0:
+    CHECK(realLength(Real(3), Real(4)) == Real(5));
 
-                            strcpy(itemImageNames[i], "airfoilItem2FEH.pic");
 
-                            itemChoices[i] = &items.airfoil.level;
+    // a few speeds between the not moving cutoff and 0.01, where distance / speed is far past 32767 ticks
 
-                            selected = true;
+    const double speeds[3] = {0.0002, 0.0015, 0.0045};
 
-                            break;
+    for (int i = 0; i < 3; i++) {
 
-                        case 1:
+        double expected = 150 / speeds[i];
 
-                            strcpy(itemImageNames[i], "airfoilItem3FEH.pic");
+        unsigned long forwards = ticksUntilOut(Real(0), Real(speeds[i]), Real(150));
 
-                            itemChoices[i] = &items.airfoil.level;
+        unsigned long backwards = ticksUntilOut(Real(150), Real(-speeds[i]), Real(150));
 
-                            selected = true;
+        // the speed itself gets rounded to 1/65536 in fixed point, so only close to it
 
-                            break;
+        CHECK(forwards > expected * 0.95 && forwards < expected * 1.05);
 
-                        default:
+        CHECK(backwards > expected * 0.95 && backwards < expected * 1.05);
 
-                            break;
+    }
 
-                    }
 
-                    break;
+    CHECK(ticksUntilOut(Real(0), Real(2), Real(150)) == 76);
 
-                case 1:
+    CHECK(ticksUntilOut(Real(160), Real(1), Real(150)) == 0);
 
-                    // based on the current level, displays the proper sprite for upgrade text
+    CHECK(ticksUntilOut(Real(50), Real(0), Real(150)) == NEVER_EXPIRES);
 
-                    switch (items.marble.level) {
+}
 
-                        case -1:
 
-                            strcpy(itemImageNames[i], "marbleItem1FEH.pic");
+// how many pushes the rewind ring check makes, more than the ring holds so it has wrapped around
 
-                            itemChoices[i] = &items.marble.level;
+const int CHECK_REWIND_PUSHES = REWIND_SLOTS + 20;
 
-                            selected = true;
 
-                            break;
+/*
 
-                        case 0:
+*   a game saved to a file and loaded back saves the same snapshot byte for byte, and the rewind ring gives back
 
-                            strcpy(itemImageNames[i], "marbleItem2FEH.pic");
+*   every snapshot it still has exactly as it went in
 
-                            itemChoices[i] = &items.marble.level;
+*/
 
-                            selected = true;
+void checkSnapshots() {
 
-                            break;
+    // a game with some of everything in it (static, all of these are big)
 
-                        case 1:
+    static GameState state;
 
-                            strcpy(itemImageNames[i], "marbleItem3FEH.pic");
+    state = GameState();
 
-                            itemChoices[i] = &items.marble.level;
+    state.tick = 777;
 
-                            selected = true;
+    state.score = 1234;
 
-                            break;
+    state.xpToNextLevel = 35;
 
-                        default:
+    state.hardMode = true;
 
-                            break;
+    state.player.transform = {150, 110, 0, 16, 32, 0, 0};
 
-                    }
+    state.player.health = {18000};
 
-                    break;
+    state.player.xp = 7;
 
-                case 2:
+    state.player.level = 6;
 
-                    // based on the current level, displays the proper sprite for upgrade text
+    state.items.marble.level = 1;
 
-                    switch (items.beam.level) {
+    state.items.beam.level = 2;
 
-                        case -1:
+    state.marbleTimer = TimeNowMSec() - 500;
 
-                            strcpy(itemImageNames[i], "beamItem1FEH.pic");
+    gameRandom.seed(99);
 
-                            itemChoices[i] = &items.beam.level;
+    for (int i = 0; i < 20; i++) {
 
-                            selected = true;
+        addEnemy(state.enemies, 10*i, 5*i, 14, 32, 3, Real(0.5), 5, 0, SPRITE_ENEMY1);
 
-                            break;
+    }
 
-                        case 0:
+    for (int i = 0; i < 8; i++) {
 
-                            strcpy(itemImageNames[i], "beamItem2FEH.pic");
+        addAttack(state.attacks, 100, 100, 4, 4, 1, 2*MARBLE_DIRECTIONS[i][0], 2*MARBLE_DIRECTIONS[i][1], 2, ITEM_MARBLE, state.tick, SPRITE_MARBLE);
 
-                            itemChoices[i] = &items.beam.level;
+    }
 
-                            selected = true;
 
-                            break;
+    static GameSnapshot saved, loaded, again;
 
-                        case 1:
+    saveSnapshot(state, saved);
 
-                            strcpy(itemImageNames[i], "beamItem3FEH.pic");
+    CHECK(writeSnapshotFile("selfCheckFEH.bin", saved));
 
-                            itemChoices[i] = &items.beam.level;
+    CHECK(readSnapshotFile("selfCheckFEH.bin", loaded));
 
-                            selected = true;
+    CHECK(memcmp(&saved, &loaded, sizeof(GameSnapshot)) == 0);
 
-                            break;
 
-                        default:
+    // the same save from a build with the other physics is turned away
 
-                            break;
+    FILE* file = fopen("selfCheckFEH.bin", "r+b");
 
-                    }
+    if (file != NULL) {
 
-                    break;
+        int otherPhysics = !SNAPSHOT_PHYSICS;
 
-                case 3:
+        fseek(file, 4 + sizeof(int), SEEK_SET);
 
-                    // based on the current level, displays the proper sprite for upgrade text
+        fwrite(&otherPhysics, sizeof(int), 1, file);
 
-                    switch (items.circuit.level) {
+        fclose(file);
 
-                        case -1:
+    }
 
-                            strcpy(itemImageNames[i], "circuitItem1FEH.pic");
+    CHECK(!readSnapshotFile("selfCheckFEH.bin", loaded));
 
-                            itemChoices[i] = &items.circuit.level;
+    remove("selfCheckFEH.bin");
 
-                            selected = true;
+    CHECK(!readSnapshotFile("missingFEH.bin", loaded));
 
-                            break;
 
-                        case 0:
+    static GameState restored;
 
-                            strcpy(itemImageNames[i], "circuitItem2FEH.pic");
+    restored = GameState();
 
-                            itemChoices[i] = &items.circuit.level;
+    gameRandom.seed(1);
 
-                            selected = true;
+    loadSnapshot(restored, saved);
 
-                            break;
+    saveSnapshot(restored, again);
 
-                        case 1:
+    CHECK(memcmp(&saved, &again, sizeof(GameSnapshot)) == 0);
 
-                            strcpy(itemImageNames[i], "circuitItem3FEH.pic");
+    CHECK(restored.score == 1234 && restored.enemies.count == 20 && restored.attacks.count == 8);
 
-                            itemChoices[i] = &items.circuit.level;
 
-                            selected = true;
+    // the ring, with the enemies moving and attacks coming and going between pushes
 
-                            break;
+    static RewindRing ring;
 
-                        default:
+    static GameSnapshot pushed[CHECK_REWIND_PUSHES];
 
-                            break;
+    ring.clear();
 
-                    }
+    for (int i = 0; i < CHECK_REWIND_PUSHES; i++) {
 
-                    break;
+        state.tick += REWIND_INTERVAL;
 
-                case 4:
+        state.score += 10;
 
-                    // ensure you cant get it first item because it does no damage
+        moveSystem(state.enemies.transform, state.enemies.velocity, state.enemies.count);
 
-                    if (items.airfoil.level == -1 && items.beam.level == -1 && items.circuit.level == -1 && items.marble.level == -1) {
+        if (i % 3 == 0) addAttack(state.attacks, 50, 60, 6, 4, 2, 0, 0, 1, ITEM_CIRCUIT, state.tick, SPRITE_CIRCUIT);
 
-                        break;
+        if (i % 5 == 0) removeAttacks(state.attacks, 0, 1);
 
-                    }
 
+        saveSnapshot(state, pushed[i]);
 
-                    // based on the current level, displays the proper sprite for upgrade text
+        pushSnapshot(ring, pushed[i]);
 
-                    switch (items.report.level) {
+    }
 
-                        case -1:
 
-                            strcpy(itemImageNames[i], "reportItem1FEH.pic");
+    int found = 0;
 
-                            itemChoices[i] = &items.report.level;
+    for (int back = 0; back < REWIND_SLOTS; back++) {
 
-                            selected = true;
+        if (!rewindSnapshot(ring, back, again)) continue;
 
-                            break;
+        CHECK(memcmp(&again, &pushed[CHECK_REWIND_PUSHES - 1 - back], sizeof(GameSnapshot)) == 0);
 
-                        case 0:
+        found++;
 
-                            strcpy(itemImageNames[i], "reportItem2FEH.pic");
+    }
 
-                            itemChoices[i] = &items.report.level;
+    // the newest keyframes cover at least (REWIND_KEYFRAMES - 1) keyframe intervals
 
-                            selected = true;
+    CHECK(found >= (REWIND_KEYFRAMES - 1) * REWIND_KEYFRAME_INTERVAL && found <= REWIND_SLOTS);
 
-                            break;
+    CHECK(!rewindSnapshot(ring, REWIND_SLOTS, again));
 
-                        case 1:
+}
 
-                            strcpy(itemImageNames[i], "reportItem3FEH.pic");
 
-                            itemChoices[i] = &items.report.level;
+// a marble ring fired as one batch ends up in exactly the rows firing them one at a time would, sorted by expire tick,
 
-                            selected = true;
+// and with only a few rows left the first ones in the batch are the ones fired
 
-                            break;
+void checkAttackBatch() {
 
-                        default:
+    static AttackArchetype batched, single;
 
-                            break;
+    for (int room = MAX_ATTACKS - 40; room >= 0; room -= 3) {
 
-                    }
+        batched = AttackArchetype();
 
-                    break;
+        for (int i = 0; i < MAX_ATTACKS - room; i++) {
 
-                default:
+            // circuits that never expire and airfoils that do, so the ring lands in between
 
-                    break;
+            bool circuit = i % 4 == 0;
 
-            }
+            addAttack(batched, 30 + i, 200 - i, 6, 4, 2, circuit ? 0 : 1, circuit ? 0 : -1, 1, circuit ? ITEM_CIRCUIT : ITEM_AIRFOIL, i, circuit ? SPRITE_CIRCUIT : SPRITE_AIRFOIL);
 
         }
 
-    }
+        single = batched;
 
 
-    // draw the menu
+        AttackSpawn ring[8];
 
-    LCD.SetFontColor(DARKGRAY);
+        for (int i = 0; i < 8; i++) {
 
-    LCD.FillRectangle(14, 14, WINDOW_WIDTH - 28, WINDOW_HEIGHT - 28);
+            ring[i] = {100, 80, 4, 4, 1, 2*MARBLE_DIRECTIONS[i][0], 2*MARBLE_DIRECTIONS[i][1], 3, ITEM_MARBLE, SPRITE_MARBLE};
 
-    LCD.SetFontColor(BLACK);
+            addAttack(single, ring[i].x, ring[i].y, 4, 4, 1, ring[i].velocityX, ring[i].velocityY, 3, ITEM_MARBLE, 60, SPRITE_MARBLE);
 
-    LCD.WriteAt("Level Up!", 105, 20);
+        }
+
+        CHECK(addAttacks(batched, ring, 8, 60) == (room >= 8));
 
 
-    LCD.DrawRectangle(20, 40, 90, 180);
+        CHECK(batched.count == single.count);
 
-    LCD.DrawRectangle(114, 40, 90, 180);
+        for (int i = 0; i < batched.count && i < single.count; i++) {
 
-    LCD.DrawRectangle(208, 40, 90, 180);
+            CHECK(batched.velocity[i].x == single.velocity[i].x && batched.velocity[i].y == single.velocity[i].y);
 
+            CHECK(batched.path[i].originX == single.path[i].originX && batched.path[i].expireTick == single.path[i].expireTick);
 
-    // open the proper sprites as selected in the loop above and draw them
+            CHECK(batched.damage[i].kind == single.damage[i].kind && batched.sprite[i].sprite == single.sprite[i].sprite);
 
-    FEHImage itemImages[3];
+            if (i > 0) CHECK(batched.path[i - 1].expireTick <= batched.path[i].expireTick);
 
-    itemImages[0].Open(itemImageNames[0]);
+        }
 
-    itemImages[1].Open(itemImageNames[1]);
+    }
 
-    itemImages[2].Open(itemImageNames[2]);
+}
 
 
-    itemImages[0].Draw(20, 40);
+/*
 
-    itemImages[1].Draw(114, 40);
+*   the alias table gives each item exactly its share of the weight, and the level up picks are always different
 
-    itemImages[2].Draw(208, 40);
+*   items that can be offered, however many are left
 
+*/
 
-    LCD.Update();
+void checkLootTable() {
 
+    LootTable table = LootTable();
 
-    float xTouch, yTouch;
+    const int weights[ITEM_COUNT] = {1, 2, 3, 0, 4};
 
+    memcpy(table.weights, weights, sizeof(weights));
 
-    // makes it so if you were holding the screen before it waits for you to let go first
+    buildLootTable(table);
 
-    while (LCD.Touch(&xTouch, &yTouch)) {}
+    CHECK(table.count == 4 && table.total == 10);
 
-   
 
-    // waits until the user picks an option and updates its level accordingly
+    // a column is kept threshold / total of the time and goes to its alias otherwise, so summed over the columns
 
-    bool madeSelection = false;
+    // an item's share has to come out to its weight times the number of columns
 
-    while (!madeSelection) {
+    for (int item = 0; item < ITEM_COUNT; item++) {
 
-        if (LCD.Touch(&xTouch, &yTouch)) {
+        int share = 0;
 
-            if (yTouch > 40 && yTouch < 220) {
+        for (int column = 0; column < table.count; column++) {
 
-                if (xTouch > 20 && xTouch < 110) {
+            if (table.items[column] == item) share += table.threshold[column];
 
-                    (*itemChoices[0])++;
+            if (table.items[table.alias[column]] == item) share += table.total - table.threshold[column];
 
-                    madeSelection = true;
+        }
 
-                }
+        CHECK(share == weights[item] * table.count);
 
-                if (xTouch > 114 && xTouch < 214) {
+    }
 
-                    (*itemChoices[1])++;
 
-                    madeSelection = true;
+    int counts[ITEM_COUNT] = {};
 
-                }
+    for (int draw = 0; draw < 1000; draw++) {
 
-                if (xTouch > 208 && xTouch < 298) {
+        int choices[3];
 
-                    (*itemChoices[2])++;
+        CHECK(drawLootChoices(table, choices, 3) == 3);
 
-                    madeSelection = true;
+        CHECK(choices[0] != choices[1] && choices[0] != choices[2] && choices[1] != choices[2]);
 
-                }
+        for (int i = 0; i < 3; i++) {
 
-            }
+            counts[choices[i]]++;
 
         }
 
     }
 
+    CHECK(counts[3] == 0);
+
+    // heavier items get offered more
+
+    CHECK(counts[0] < counts[1] && counts[1] < counts[2] && counts[2] < counts[4]);
+
+
+    // only one item left to offer
+
+    memset(table.weights, 0, sizeof(table.weights));
+
+    table.weights[ITEM_BEAM] = 5;
+
+    buildLootTable(table);
+
+    int choices[3];
+
+    CHECK(drawLootChoices(table, choices, 3) == 1 && choices[0] == ITEM_BEAM);
+
 }
 
 
-/*
+// runs every check, returns how many failed
 
-*   removes an object from an array by moving everything above it down 1.
+int runSelfChecks() {
 
-*   uses template type T so the method can be used for any object type
+    checkFixedPoint();
 
-*
+    checkSnapshots();
 
-*   @author Ryan
+    checkAttackBatch();
 
-*/
+    checkLootTable();
 
-template <class T>
+    checkSpriteRuns();
 
-void removeFromArray(T array[], int arraySize, int indexToRemove) {
+    checkAssetPackBounds();
 
-    // moves everything above the thing to remove the the array down by 1
+    checkWaveScript();
 
-    for (int i = indexToRemove; i < arraySize - 1; i++) {
 
-        array[i] = array[i + 1];
+    printf("self checks: %d failed\n", selfCheckFailures);
 
-    }
+    return selfCheckFailures;
 
 }
 
+#endif
 
 
 int main() {
 
+#ifdef SELF_TEST
+
+    // no game, just the checks
+
+    return runSelfChecks() > 0 ? 1 : 0;
+
+#endif
+
+
     // Clear background
 
     LCD.SetBackgroundColor(BLACK);
 
 
-    menu();
+    // use the asset pack if there is one, otherwise sprites come from the .pic files
+
+    openAssetPack("assetsFEH.pak");
+
+
+    // use the designers' waves if there are any, otherwise the built in ones
+
+    loadWaveScript("wavesFEH.txt");
+
+
+    // start loading what the game needs while the menu is up
+
+    startAssetLoader();
+
+    preloadGameSprites();
+
 
+#ifdef BENCHMARK
+
+    // no game either, just time the renderer and how much a frame can hold, and print how they did
+
+    benchmarkBlits();
+
+    benchmarkCapacity();
+
+    stopAssetLoader();
 
     return 0;
 
-}
+#endif
 
 
-/*
+#ifdef BOT
 
-*   displays the main menu
+    // no menu for the bot, it goes straight to the difficulty menu and plays BOT_GAMES games back to back
 
-*
+    pushScene(SCENE_DIFFICULTY);
 
-*   @author Ryan, Meenakshi
+#else
 
-*/
+    pushScene(SCENE_MAIN_MENU);
 
-void menu() {
+#endif
 
-    LCD.Clear();
 
+    // runs until every scene is gone, which on the Proteus is never
 
-    // Set up and draw menu
+    runScenes();
 
-    FEHIcon::Icon menu[4];
 
-    char menuLabels[4][20] = {"PLAY","STATS","INFO","CREDITS"};
+    stopAssetLoader();
 
-    FEHIcon::DrawIconArray(menu, 2, 2, 10, 10, 5, 5, menuLabels, RED, GOLD);
+    return 0;
 
+}
 
-    // draw the logo
 
-    FEHImage logo;
+// starts a scene that was just pushed, for the scenes that do more than draw themselves
 
-    logo.Open("logoFEH.pic");
+void startScene(int type) {
 
-    logo.Draw(100,98);
+    switch (type) {
 
+        case SCENE_DIFFICULTY: startDifficultyMenu(); break;
 
-    // keeps track of where touch location is
+        case SCENE_GAME: startGame(); break;
 
-    float x, y;
+        case SCENE_LEVEL_UP: startLevelUp(); break;
 
+    }
 
-    // makes it so if you were holding the screen before it waits for you to let go first
+}
 
-    while (LCD.Touch(&x, &y)) {}
 
+// draws a scene when it comes on top
 
-    // initialize statistics
+void showScene(int type) {
 
-    int gamesPlayed = 0;
+    switch (type) {
 
-    int highscore = 0;
+        case SCENE_MAIN_MENU: showMainMenu(); break;
 
+        case SCENE_DIFFICULTY: showDifficultyMenu(); break;
 
-    // this loop runs forever until the game is closed
+        case SCENE_GAME: showGame(); break;
 
-    while (true) {
+        case SCENE_LEVEL_UP: showLevelUp(); break;
 
-        if (LCD.Touch(&x, &y)) {
+        case SCENE_GAME_OVER: showGameOver(); break;
 
-            if (menu[0].Pressed(x, y, 0)) {
+        case SCENE_STATS: showStats(); break;
 
-                // increment games played, run the game and store the score
+        case SCENE_INFO: showInfo(); break;
 
-                gamesPlayed++;
+        case SCENE_CREDITS: showCredits(); break;
 
-                int score = game();
+    }
 
+}
 
-                // if score is higher than highscore, update value
 
-                if (highscore < score) highscore = score;
+// hands a touch to a menu. the buttons go as soon as they are touched, the rest of the screens go back once they've been tapped
 
-            }
+void touchScene(int type, int event, float x, float y) {
 
-            if (menu[1].Pressed(x, y, 0)) {
+    switch (type) {
 
-                stats(gamesPlayed, highscore);
+        case SCENE_MAIN_MENU:
 
-            }
+            if (event != TOUCH_UP) touchMainMenu(x, y);
 
-            if (menu[2].Pressed(x, y, 0)) {
+            break;
 
-                info();
+        case SCENE_DIFFICULTY:
 
-            }
+            if (event != TOUCH_UP) touchDifficultyMenu(x, y);
 
-            if (menu[3].Pressed(x, y, 0)) {
+            break;
 
-                credits();
+        case SCENE_LEVEL_UP:
 
-            }
+            if (event != TOUCH_UP) touchLevelUp(x, y);
 
+            break;
 
-            // after coming back from a menu option, redraw the main menu
+        case SCENE_GAME_OVER:
 
-            LCD.Clear();
+            touchGameOver(event, x, y);
 
-            FEHIcon::DrawIconArray(menu, 2, 2, 10, 10, 5, 5, menuLabels, RED, GOLD);
+            break;
 
-            logo.Draw(100,98);
+        default:
 
+            if (event == TOUCH_UP) popScene();
 
-        }
+            break;
 
     }
 
+}
+
+
+/*
+
+*   displays the main menu
+
+*
+
+*   @author Ryan, Meenakshi
+
+*/
+
+FEHIcon::Icon mainMenu[4];
+
+
+void showMainMenu() {
+
+    LCD.Clear();
+
+
+    // Set up and draw menu
+
+    char menuLabels[4][20] = {"PLAY","STATS","INFO","CREDITS"};
+
+    FEHIcon::DrawIconArray(mainMenu, 2, 2, 10, 10, 5, 5, menuLabels, RED, GOLD);
+
+
+    // draw the logo
+
+    drawSpriteToLCD(getSprite("logoFEH.pic"), 100, 98);
+
+}
+
+
+void touchMainMenu(float x, float y) {
 
-    logo.Close();
+    if (mainMenu[0].Pressed(x, y, 0)) {
+
+        // a game that was left going picks up where it was, otherwise the difficulty gets picked first
+
+        session.startFrom = readSavedGame();
+
+        pushScene(session.startFrom != NULL ? SCENE_GAME : SCENE_DIFFICULTY);
+
+    } else if (mainMenu[1].Pressed(x, y, 0)) {
+
+        pushScene(SCENE_STATS);
+
+    } else if (mainMenu[2].Pressed(x, y, 0)) {
+
+        pushScene(SCENE_INFO);
+
+    } else if (mainMenu[3].Pressed(x, y, 0)) {
+
+        pushScene(SCENE_CREDITS);
+
+    }
 
 }
 
@@ -2077,7 +9305,7 @@ void menu() {
 
 */
 
-void stats(int gamesPlayed, int highscore) {
+void showStats() {
 
     LCD.Clear();
 
@@ -2088,22 +9316,11 @@ void stats(int gamesPlayed, int highscore) {
 
     LCD.WriteAt("Games Played: ", 50, 50);
 
-    LCD.WriteAt(gamesPlayed, 100, 70);
+    LCD.WriteAt(records.gamesPlayed, 100, 70);
 
     LCD.WriteAt("High Score: ", 50, 120);
 
-    LCD.WriteAt(highscore, 100, 140);
-
-
-    // wait for user to let go and tap the screen again
-
-    float x, y;
-
-    while (LCD.Touch(&x, &y));
-
-    while (!LCD.Touch(&x, &y));
-
-    while (LCD.Touch(&x, &y));
+    LCD.WriteAt(records.highscore, 100, 140);
 
 }
 
@@ -2118,7 +9335,7 @@ void stats(int gamesPlayed, int highscore) {
 
 */
 
-void info() {
+void showInfo() {
 
     LCD.Clear();
 
@@ -2135,17 +9352,6 @@ void info() {
 
     LCD.WriteAt("Level up & get new items!", 10, 110);
 
-
-    // wait for user to let go and tap the screen again
-
-    float x, y;
-
-    while (LCD.Touch(&x, &y));
-
-    while (!LCD.Touch(&x, &y));
-
-    while (LCD.Touch(&x, &y));
-
 }
 
 
@@ -2159,7 +9365,7 @@ void info() {
 
 */
 
-void credits() {
+void showCredits() {
 
     LCD.Clear();
 
@@ -2176,15 +9382,4 @@ void credits() {
 
     LCD.WriteAt("Agi Jobe", 20, 90);
 
-
-    // wait for user to let go and tap the screen again
-
-    float x, y;
-
-    while (LCD.Touch(&x, &y));
-
-    while (!LCD.Touch(&x, &y));
-
-    while (LCD.Touch(&x, &y));
-
 }
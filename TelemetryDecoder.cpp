@@ -0,0 +1,295 @@
+// turns the binary telemetry file written by FEH Survivors into CSV
+
+// usage: TelemetryDecoder telemetryFEH.bin > telemetry.csv
+
+//        TelemetryDecoder -s telemetryFEH.bin      (per run summary instead of every event)
+
+
+#include "TelemetryFormat.h"
+
+
+#include <cstdio>
+
+#include <cstring>
+
+
+const char EVENT_NAMES[TELEMETRY_EVENT_COUNT][20] = {"game_start", "enemy_killed", "player_hurt", "level_up", "item_picked", "game_over", "events_dropped"};
+
+const char ITEM_NAMES[ITEM_COUNT + 1][20] = {"marble", "airfoil", "beam", "circuit", "report", "none"};
+
+
+// name for an enemy type, bosses are ENEMY_BOSS_TYPE above their sprite number
+
+void enemyName(int type, char name[]) {
+
+    if (type >= ENEMY_BOSS_TYPE) {
+
+        sprintf(name, "boss%d", type - ENEMY_BOSS_TYPE + 1);
+
+    } else {
+
+        sprintf(name, "enemy%d", type + 1);
+
+    }
+
+}
+
+
+// name of whatever the subject of the event is
+
+void subjectName(const TelemetryEvent& event, char name[]) {
+
+    switch (event.type) {
+
+        case TELEMETRY_ENEMY_KILLED:
+
+        case TELEMETRY_ITEM_PICKED:
+
+            strcpy(name, ITEM_NAMES[event.subject <= ITEM_COUNT ? event.subject : (int)ITEM_COUNT]);
+
+            break;
+
+        case TELEMETRY_PLAYER_HURT:
+
+            enemyName(event.subject, name);
+
+            break;
+
+        default:
+
+            sprintf(name, "%d", event.subject);
+
+            break;
+
+    }
+
+}
+
+
+/*
+
+*   totals for one run, printed when the next run starts or the file ends
+
+*/
+
+struct RunSummary {
+
+    int run;
+
+    int kills[ITEM_COUNT + 1];
+
+    int damageTaken[2 * ENEMY_BOSS_TYPE];
+
+    unsigned int levelTime[16];
+
+    int levels;
+
+    int picks[ITEM_COUNT];
+
+    int score;
+
+    unsigned int length;
+
+    int dropped;
+
+};
+
+
+void printSummary(const RunSummary& summary) {
+
+    char name[20];
+
+
+    printf("run,%d,length_ms,%u,score,%d\n", summary.run, summary.length, summary.score);
+
+    if (summary.dropped > 0) printf("run,%d,events_dropped,%d\n", summary.run, summary.dropped);
+
+    for (int i = 0; i <= ITEM_COUNT; i++) {
+
+        if (summary.kills[i] > 0) printf("run,%d,kills,%s,%d\n", summary.run, ITEM_NAMES[i], summary.kills[i]);
+
+    }
+
+    for (int i = 0; i < 2 * ENEMY_BOSS_TYPE; i++) {
+
+        enemyName(i, name);
+
+        if (summary.damageTaken[i] > 0) printf("run,%d,damage_taken,%s,%d\n", summary.run, name, summary.damageTaken[i]);
+
+    }
+
+    for (int i = 1; i <= summary.levels && i < 16; i++) {
+
+        printf("run,%d,time_to_level,%d,%u\n", summary.run, i, summary.levelTime[i]);
+
+    }
+
+    for (int i = 0; i < ITEM_COUNT; i++) {
+
+        if (summary.picks[i] > 0) printf("run,%d,picks,%s,%d\n", summary.run, ITEM_NAMES[i], summary.picks[i]);
+
+    }
+
+}
+
+
+int main(int argc, char* argv[]) {
+
+    bool summaryMode = argc > 2 && strcmp(argv[1], "-s") == 0;
+
+    const char* fileName = argv[argc - 1];
+
+
+    if (argc < 2) {
+
+        fprintf(stderr, "usage: %s [-s] telemetryFEH.bin\n", argv[0]);
+
+        return 1;
+
+    }
+
+
+    FILE* file = fopen(fileName, "rb");
+
+    if (file == NULL) {
+
+        fprintf(stderr, "couldn't open %s\n", fileName);
+
+        return 1;
+
+    }
+
+
+    // check the header matches what this decoder knows how to read
+
+    char magic[4];
+
+    int version, eventSize;
+
+    if (fread(magic, 4, 1, file) != 1 || fread(&version, sizeof(int), 1, file) != 1 || fread(&eventSize, sizeof(int), 1, file) != 1 ||
+
+        memcmp(magic, TELEMETRY_MAGIC, 4) != 0 || version != TELEMETRY_VERSION || eventSize != sizeof(TelemetryEvent)) {
+
+        fprintf(stderr, "%s is not a version %d telemetry file\n", fileName, TELEMETRY_VERSION);
+
+        fclose(file);
+
+        return 1;
+
+    }
+
+
+    if (!summaryMode) printf("run,time_ms,tick,event,subject,value\n");
+
+
+    RunSummary summary;
+
+    memset(&summary, 0, sizeof(summary));
+
+    int run = 0;
+
+    char name[20];
+
+
+    // read in chunks, each event is copied straight from the file
+
+    TelemetryEvent events[1024];
+
+    size_t count;
+
+    while ((count = fread(events, sizeof(TelemetryEvent), 1024, file)) > 0) {
+
+        for (size_t i = 0; i < count; i++) {
+
+            const TelemetryEvent& event = events[i];
+
+            if (event.type >= TELEMETRY_EVENT_COUNT) continue;
+
+
+            // every game start is the beginning of a new run
+
+            if (event.type == TELEMETRY_GAME_START) {
+
+                if (summaryMode && run > 0) printSummary(summary);
+
+                run++;
+
+                memset(&summary, 0, sizeof(summary));
+
+                summary.run = run;
+
+            }
+
+
+            if (!summaryMode) {
+
+                subjectName(event, name);
+
+                printf("%d,%u,%u,%s,%s,%d\n", run, event.time, event.tick, EVENT_NAMES[event.type], name, event.value);
+
+                continue;
+
+            }
+
+
+            summary.length = event.time;
+
+            switch (event.type) {
+
+                case TELEMETRY_ENEMY_KILLED:
+
+                    summary.kills[event.subject <= ITEM_COUNT ? event.subject : (int)ITEM_COUNT]++;
+
+                    break;
+
+                case TELEMETRY_PLAYER_HURT:
+
+                    if (event.subject < 2 * ENEMY_BOSS_TYPE) summary.damageTaken[event.subject] += event.value;
+
+                    break;
+
+                case TELEMETRY_LEVEL_UP:
+
+                    if (event.subject < 16) summary.levelTime[event.subject] = event.time;
+
+                    summary.levels = event.subject;
+
+                    break;
+
+                case TELEMETRY_ITEM_PICKED:
+
+                    if (event.subject < ITEM_COUNT) summary.picks[event.subject]++;
+
+                    break;
+
+                case TELEMETRY_GAME_OVER:
+
+                    summary.score = event.value;
+
+                    break;
+
+                case TELEMETRY_EVENTS_DROPPED:
+
+                    summary.dropped = event.value;
+
+                    break;
+
+                default:
+
+                    break;
+
+            }
+
+        }
+
+    }
+
+
+    if (summaryMode && run > 0) printSummary(summary);
+
+
+    fclose(file);
+
+    return 0;
+
+}
@@ -0,0 +1,84 @@
+// telemetry file format for FEH Survivors, shared by the game and the telemetry decoder
+
+
+#ifndef TELEMETRYFORMAT_H
+
+#define TELEMETRYFORMAT_H
+
+
+// ids for each item, also used to say which weapon an attack came from
+
+enum ItemId {
+
+    ITEM_MARBLE = 0,
+
+    ITEM_AIRFOIL,
+
+    ITEM_BEAM,
+
+    ITEM_CIRCUIT,
+
+    ITEM_REPORT,
+
+    ITEM_COUNT
+
+};
+
+
+// enemy types are the sprite number (0 to 4), plus this if it spawned as a boss
+
+const int ENEMY_BOSS_TYPE = 5;
+
+
+// kinds of events, what the subject and value mean depends on the event
+
+enum TelemetryEventType {
+
+    TELEMETRY_GAME_START = 0, // subject: 1 if hard mode
+
+    TELEMETRY_ENEMY_KILLED,   // subject: item id of the killing hit, value: enemy type
+
+    TELEMETRY_PLAYER_HURT,    // subject: enemy type, value: damage taken from that type since its last PLAYER_HURT
+
+    TELEMETRY_LEVEL_UP,       // subject: new level, value: score
+
+    TELEMETRY_ITEM_PICKED,    // subject: item id, value: new item level
+
+    TELEMETRY_GAME_OVER,      // value: final score
+
+    TELEMETRY_EVENTS_DROPPED, // value: events the run lost because the ring was full, always the last event of a run
+
+    TELEMETRY_EVENT_COUNT
+
+};
+
+
+/*
+
+*   one event, always 16 bytes so the game can copy it into the ring without any formatting
+
+*/
+
+struct TelemetryEvent {
+
+    unsigned int time; // ms since the game started
+
+    unsigned int tick;
+
+    unsigned short type;
+
+    unsigned short subject;
+
+    int value;
+
+};
+
+
+// a telemetry file is the magic, the version, the size of one event, then events until the end of the file
+
+const char TELEMETRY_MAGIC[4] = {'F', 'E', 'H', 'T'};
+
+const int TELEMETRY_VERSION = 1;
+
+
+#endif
@@ -0,0 +1,42 @@
+// headless stand-in for the FEH Proteus image library, draws .pic files onto the headless LCD
+
+
+#ifndef FEHIMAGES_H
+
+#define FEHIMAGES_H
+
+
+/*
+
+*   an image loaded from a .pic file (height and width, then one color per pixel with -1 for see-through)
+
+*/
+
+class FEHImage {
+
+public:
+
+    FEHImage();
+
+    ~FEHImage();
+
+
+    void Open(const char fileName[]);
+
+    // draws it with its top left corner at (x, y)
+
+    void Draw(int x, int y);
+
+    void Close();
+
+
+private:
+
+    int width, height;
+
+    int* pixels;
+
+};
+
+
+#endif
@@ -0,0 +1,183 @@
+// headless stand-in for the FEH Proteus LCD library: the screen is memory, touches come from a script
+
+// (see Headless.cpp), so the game can run and be checked on a PC
+
+
+#ifndef FEHLCD_H
+
+#define FEHLCD_H
+
+
+// colors are 0xRRGGBB like on the Proteus
+
+#define BLACK 0x000000u
+
+#define WHITE 0xFFFFFFu
+
+#define RED 0xFF0000u
+
+#define GREEN 0x008000u
+
+#define BLUE 0x0000FFu
+
+#define YELLOW 0xFFFF00u
+
+#define ORANGE 0xFFA500u
+
+#define PURPLE 0x800080u
+
+#define GOLD 0xFFD700u
+
+#define SILVER 0xC0C0C0u
+
+#define BROWN 0xA52A2Au
+
+#define GRAY 0x808080u
+
+#define DARKGRAY 0xA9A9A9u
+
+
+/*
+
+*   the LCD, drawn into headlessScreen (Headless.h) instead of the display. text is 12x17 pixels a character
+
+*   like the Proteus font, with a plainer font. every call is counted and timed
+
+*/
+
+class FEHLCD {
+
+public:
+
+    FEHLCD();
+
+
+    void Clear();
+
+    void Clear(unsigned int color);
+
+    void SetFontColor(unsigned int color);
+
+    void SetBackgroundColor(unsigned int color);
+
+
+    void DrawPixel(int x, int y);
+
+    void DrawHorizontalLine(int y, int x1, int x2);
+
+    void DrawVerticalLine(int x, int y1, int y2);
+
+    void DrawLine(int x1, int y1, int x2, int y2);
+
+    void DrawRectangle(int x, int y, int width, int height);
+
+    void FillRectangle(int x, int y, int width, int height);
+
+    void DrawCircle(int x, int y, int radius);
+
+    void FillCircle(int x, int y, int radius);
+
+
+    void Write(const char text[]);
+
+    void Write(int value);
+
+    void Write(float value);
+
+    void Write(double value);
+
+    void WriteLine(const char text[]);
+
+    void WriteLine(int value);
+
+    void WriteLine(float value);
+
+    void WriteLine(double value);
+
+    void WriteAt(const char text[], int x, int y);
+
+    void WriteAt(int value, int x, int y);
+
+    void WriteAt(float value, int x, int y);
+
+    void WriteAt(double value, int x, int y);
+
+
+    // the next touch from the script, false if it says the screen isn't being touched
+
+    bool Touch(float* x, float* y);
+
+    void Update();
+
+
+private:
+
+    unsigned int fontColor, backgroundColor;
+
+    int cursorX, cursorY;
+
+};
+
+
+extern FEHLCD LCD;
+
+
+namespace FEHIcon {
+
+
+/*
+
+*   a labeled button: a rectangle with its label in the middle
+
+*/
+
+class Icon {
+
+public:
+
+    Icon();
+
+
+    void SetProperties(const char name[20], int x, int y, int width, int height, unsigned int color, unsigned int textColor);
+
+    void Draw();
+
+    void Select();
+
+    void Deselect();
+
+    // 1 if (x, y) is on the icon. with persist it is also left drawn as selected
+
+    int Pressed(float x, float y, int persist);
+
+    int WhilePressed(float x, float y);
+
+    void ChangeLabelString(const char label[20]);
+
+    void ChangeLabelInt(int value);
+
+    void ChangeLabelFloat(float value);
+
+
+private:
+
+    char label[20];
+
+    int x, y, width, height;
+
+    unsigned int color, textColor;
+
+    bool selected;
+
+};
+
+
+// lays icons out in a rows by cols grid filling the screen inside the margins, and draws them
+
+void DrawIconArray(Icon icons[], int rows, int cols, int top, int bottom, int left, int right, char labels[][20], unsigned int color, unsigned int textColor);
+
+
+}
+
+
+#endif
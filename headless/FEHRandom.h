@@ -0,0 +1,33 @@
+// headless stand-in for the FEH Proteus random number library
+
+
+#ifndef FEHRANDOM_H
+
+#define FEHRANDOM_H
+
+
+// random numbers from 0 to 32767. seeds from the clock, so with the stepped clock they are the same every run
+
+class FEHRandom {
+
+public:
+
+    FEHRandom();
+
+
+    void Seed();
+
+    int RandInt();
+
+
+private:
+
+    unsigned int state;
+
+};
+
+
+extern FEHRandom Random;
+
+
+#endif
@@ -0,0 +1,25 @@
+// headless stand-in for the FEH Proteus utility library. the clock is stepped by the input script
+
+// (see Headless.cpp), so a scripted run gets the same times every run
+
+
+#ifndef FEHUTILITY_H
+
+#define FEHUTILITY_H
+
+
+unsigned long TimeNowMSec();
+
+double TimeNow();
+
+
+// moves the stepped clock on instead of waiting, unless the script asks for the real time
+
+void Sleep(int milliseconds);
+
+void Sleep(float seconds);
+
+void Sleep(double seconds);
+
+
+#endif
@@ -0,0 +1,1309 @@
+// headless FEH Proteus libraries for FEH Survivors: the LCD draws into memory, touches come from a script and every
+
+// library call is counted and timed, so screens can be checked against saved images on a PC without the Proteus
+
+
+// build the game against it with   g++ -Iheadless FEHSurvivors.cpp headless/Headless.cpp
+
+
+#include "FEHLCD.h"
+
+#include "FEHImages.h"
+
+#include "FEHUtility.h"
+
+#include "FEHRandom.h"
+
+#include "Headless.h"
+
+
+#include <algorithm>
+
+#include <chrono>
+
+#include <cstdio>
+
+#include <cstdlib>
+
+#include <cstring>
+
+#include <thread>
+
+
+FEHLCD LCD;
+
+FEHRandom Random;
+
+
+// everything below that isn't in the FEH headers or Headless.h is static, so it can't clash with the game's own names
+
+
+unsigned int headlessScreen[HEADLESS_HEIGHT][HEADLESS_WIDTH];
+
+
+const int CHAR_WIDTH = 12;
+
+const int CHAR_HEIGHT = 17;
+
+
+/*
+
+*   call counts and times
+
+*/
+
+
+const char HEADLESS_CALL_NAMES[HEADLESS_CALL_COUNT][24] = {
+
+    "Clear", "SetFontColor", "SetBackgroundColor",
+
+    "DrawPixel", "DrawHorizontalLine", "DrawVerticalLine", "DrawLine",
+
+    "DrawRectangle", "FillRectangle", "DrawCircle", "FillCircle",
+
+    "Write", "WriteAt", "Touch", "Update",
+
+    "Icon::Draw", "Icon::Pressed", "DrawIconArray",
+
+    "FEHImage::Open", "FEHImage::Draw"
+
+};
+
+
+struct CallStats {
+
+    unsigned long count;
+
+    long long nanoseconds;
+
+};
+
+
+static CallStats callStats[HEADLESS_CALL_COUNT];
+
+
+// counts a call and times it until the end of the scope it's in
+
+struct CallTimer {
+
+    HeadlessCall call;
+
+    std::chrono::steady_clock::time_point start;
+
+
+    CallTimer(HeadlessCall call) : call(call), start(std::chrono::steady_clock::now()) {}
+
+    ~CallTimer() {
+
+        callStats[call].count++;
+
+        callStats[call].nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    }
+
+};
+
+
+void printCallStats(const char label[]) {
+
+    printf("%s:\n", label);
+
+    printf("    %-20s %8s %12s %10s\n", "call", "count", "total us", "each us");
+
+
+    unsigned long count = 0;
+
+    long long nanoseconds = 0;
+
+    for (int i = 0; i < HEADLESS_CALL_COUNT; i++) {
+
+        if (callStats[i].count == 0) continue;
+
+        printf("    %-20s %8lu %12.1f %10.3f\n", HEADLESS_CALL_NAMES[i], callStats[i].count,
+
+               callStats[i].nanoseconds / 1000.0, callStats[i].nanoseconds / 1000.0 / callStats[i].count);
+
+        count += callStats[i].count;
+
+        nanoseconds += callStats[i].nanoseconds;
+
+    }
+
+    printf("    %-20s %8lu %12.1f\n", "all", count, nanoseconds / 1000.0);
+
+
+    memset(callStats, 0, sizeof(callStats));
+
+}
+
+
+/*
+
+*   the screen as images
+
+*/
+
+
+bool writeScreenPPM(const char fileName[]) {
+
+    FILE* file = fopen(fileName, "wb");
+
+    if (file == NULL) return false;
+
+
+    fprintf(file, "P6\n%d %d\n255\n", HEADLESS_WIDTH, HEADLESS_HEIGHT);
+
+    for (int y = 0; y < HEADLESS_HEIGHT; y++) {
+
+        for (int x = 0; x < HEADLESS_WIDTH; x++) {
+
+            unsigned int color = headlessScreen[y][x];
+
+            unsigned char rgb[3] = {(unsigned char)(color >> 16), (unsigned char)(color >> 8), (unsigned char)color};
+
+            fwrite(rgb, 1, 3, file);
+
+        }
+
+    }
+
+
+    fclose(file);
+
+    return true;
+
+}
+
+
+int compareScreenPPM(const char fileName[]) {
+
+    FILE* file = fopen(fileName, "rb");
+
+    if (file == NULL) return -1;
+
+
+    // header is P6, width, height and the largest value, then one whitespace before the pixels
+
+    int width, height, maxValue;
+
+    if (fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) != 3 || fgetc(file) == EOF ||
+
+        width != HEADLESS_WIDTH || height != HEADLESS_HEIGHT || maxValue != 255) {
+
+        fclose(file);
+
+        return -1;
+
+    }
+
+
+    int differences = 0;
+
+    for (int y = 0; y < HEADLESS_HEIGHT; y++) {
+
+        for (int x = 0; x < HEADLESS_WIDTH; x++) {
+
+            unsigned char rgb[3];
+
+            if (fread(rgb, 1, 3, file) != 3) {
+
+                fclose(file);
+
+                return -1;
+
+            }
+
+            if ((unsigned int)(rgb[0] << 16 | rgb[1] << 8 | rgb[2]) != headlessScreen[y][x]) differences++;
+
+        }
+
+    }
+
+
+    fclose(file);
+
+    return differences;
+
+}
+
+
+/*
+
+*   the clock. stepped by LCD.Touch unless the script asks for the real time
+
+*/
+
+
+static unsigned long clockTime = 0;
+
+static int clockStep = 33;
+
+static bool realClock = false;
+
+
+unsigned long TimeNowMSec() {
+
+    if (realClock) {
+
+        static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    }
+
+    return clockTime;
+
+}
+
+
+double TimeNow() {
+
+    return TimeNowMSec() / 1000.0;
+
+}
+
+
+void Sleep(int milliseconds) {
+
+    if (milliseconds <= 0) return;
+
+    if (realClock) {
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+
+    } else {
+
+        clockTime += milliseconds;
+
+    }
+
+}
+
+
+void Sleep(float seconds) {
+
+    Sleep((int)(seconds * 1000));
+
+}
+
+
+void Sleep(double seconds) {
+
+    Sleep((int)(seconds * 1000));
+
+}
+
+
+FEHRandom::FEHRandom() : state(1) {}
+
+
+void FEHRandom::Seed() {
+
+    state = TimeNowMSec() + 1;
+
+}
+
+
+int FEHRandom::RandInt() {
+
+    state = state * 1103515245u + 12345u;
+
+    return (state >> 16) & 0x7FFF;
+
+}
+
+
+/*
+
+*   the input script, read a line at a time as the game reads the touch screen. one command per line, # starts a comment:
+
+*       touch X Y [N]   touch (X, Y) for the next N reads of LCD.Touch (1 if left out)
+
+*       wait [N]        don't touch for the next N reads
+
+*       dump FILE       write the screen to FILE as a PPM
+
+*       expect FILE     check the screen against the PPM in FILE. if it differs the run fails, and what
+
+*                       was on the screen is written next to it as FILE.actual.ppm
+
+*       stats LABEL     print the calls made since the last stats (what it cost to draw this screen)
+
+*       clock N         each read of LCD.Touch moves the clock on N milliseconds (33 to start with)
+
+*       clock real      use the real time instead (runs won't repeat exactly any more)
+
+*       quit            stop here
+
+*   the game only waits for input in LCD.Touch, so dump, expect and stats see the screen as it was when it was
+
+*   last read. when the script is done the program ends, with exit code 1 if an expect failed or the script had a mistake
+
+*/
+
+
+const char DEFAULT_SCRIPT[] = "headlessFEH.txt";
+
+
+struct InputScript {
+
+    bool opened;
+
+    FILE* file;
+
+    const char* fileName;
+
+    int line;
+
+
+    // the touch or wait being played back, and how many more reads it lasts
+
+    bool touching;
+
+    float x, y;
+
+    int reads;
+
+
+    int expects, failures;
+
+};
+
+
+static InputScript script;
+
+
+// ends the program. straight out, because the game never leaves its menu loop on its own
+
+static void endScript() {
+
+    printCallStats("end");
+
+    if (script.expects > 0) {
+
+        printf("%d of %d expects matched\n", script.expects - script.failures, script.expects);
+
+    }
+
+    if (script.file != NULL) fclose(script.file);
+
+
+    fflush(stdout);
+
+    fflush(stderr);
+
+    std::_Exit(script.failures > 0 ? 1 : 0);
+
+}
+
+
+// a mistake in the script fails the run
+
+static void scriptError(const char message[]) {
+
+    fprintf(stderr, "%s line %d: %s\n", script.fileName, script.line, message);
+
+    script.failures++;
+
+    endScript();
+
+}
+
+
+// checks the screen against a saved image
+
+static void expectScreen(const char fileName[]) {
+
+    script.expects++;
+
+
+    int differences = compareScreenPPM(fileName);
+
+    if (differences == 0) return;
+
+
+    char actual[256];
+
+    snprintf(actual, sizeof(actual), "%s.actual.ppm", fileName);
+
+    writeScreenPPM(actual);
+
+
+    if (differences < 0) {
+
+        printf("expect %s: couldn't read it (the screen is in %s)\n", fileName, actual);
+
+    } else {
+
+        printf("expect %s: %d pixels differ (the screen is in %s)\n", fileName, differences, actual);
+
+    }
+
+    script.failures++;
+
+}
+
+
+// runs the next line of the script
+
+static void runScriptLine() {
+
+    char text[256];
+
+    if (fgets(text, sizeof(text), script.file) == NULL) endScript();
+
+    script.line++;
+
+
+    char* comment = strchr(text, '#');
+
+    if (comment != NULL) *comment = '\0';
+
+
+    char command[16];
+
+    char argument[200];
+
+    if (sscanf(text, "%15s", command) != 1) return;
+
+
+    if (strcmp(command, "touch") == 0) {
+
+        int reads = 1;
+
+        if (sscanf(text, "%*s %f %f %d", &script.x, &script.y, &reads) < 2 || reads < 1) scriptError("touch needs X Y [N]");
+
+        script.touching = true;
+
+        script.reads = reads;
+
+    } else if (strcmp(command, "wait") == 0) {
+
+        int reads = 1;
+
+        sscanf(text, "%*s %d", &reads);
+
+        if (reads < 1) scriptError("wait needs a count of at least 1");
+
+        script.touching = false;
+
+        script.reads = reads;
+
+    } else if (strcmp(command, "dump") == 0) {
+
+        if (sscanf(text, "%*s %199s", argument) != 1) scriptError("dump needs a file name");
+
+        if (!writeScreenPPM(argument)) scriptError("couldn't write the dump");
+
+    } else if (strcmp(command, "expect") == 0) {
+
+        if (sscanf(text, "%*s %199s", argument) != 1) scriptError("expect needs a file name");
+
+        expectScreen(argument);
+
+    } else if (strcmp(command, "stats") == 0) {
+
+        if (sscanf(text, "%*s %199s", argument) != 1) strcpy(argument, "stats");
+
+        printCallStats(argument);
+
+    } else if (strcmp(command, "clock") == 0) {
+
+        if (sscanf(text, "%*s %199s", argument) != 1) scriptError("clock needs a step or real");
+
+        if (strcmp(argument, "real") == 0) {
+
+            realClock = true;
+
+        } else if (sscanf(argument, "%d", &clockStep) != 1 || clockStep < 0) {
+
+            scriptError("clock needs a step or real");
+
+        }
+
+    } else if (strcmp(command, "quit") == 0) {
+
+        endScript();
+
+    } else {
+
+        scriptError("unknown command");
+
+    }
+
+}
+
+
+// the next touch, running the script up to the next touch or wait. the script is HEADLESS_SCRIPT or headlessFEH.txt
+
+static bool nextTouch(float& x, float& y) {
+
+    if (!script.opened) {
+
+        script.opened = true;
+
+        script.fileName = getenv("HEADLESS_SCRIPT") != NULL ? getenv("HEADLESS_SCRIPT") : DEFAULT_SCRIPT;
+
+        script.file = fopen(script.fileName, "r");
+
+        if (script.file == NULL) {
+
+            fprintf(stderr, "couldn't open %s, nothing to play\n", script.fileName);
+
+            script.failures++;
+
+            endScript();
+
+        }
+
+    }
+
+
+    while (script.reads == 0) runScriptLine();
+
+    script.reads--;
+
+
+    if (script.touching) {
+
+        x = script.x;
+
+        y = script.y;
+
+    }
+
+    return script.touching;
+
+}
+
+
+/*
+
+*   drawing
+
+*/
+
+
+// one pixel, ignoring anything off screen
+
+static inline void setPixel(int x, int y, unsigned int color) {
+
+    if (x < 0 || x >= HEADLESS_WIDTH || y < 0 || y >= HEADLESS_HEIGHT) return;
+
+    headlessScreen[y][x] = color & 0xFFFFFF;
+
+}
+
+
+static void fillRectangle(int x, int y, int width, int height, unsigned int color) {
+
+    for (int row = y; row < y + height; row++) {
+
+        for (int col = x; col < x + width; col++) setPixel(col, row, color);
+
+    }
+
+}
+
+
+// bresenham's algorithm
+
+static void drawLine(int x0, int y0, int x1, int y1, unsigned int color) {
+
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+
+    int dy = y1 > y0 ? y0 - y1 : y1 - y0;
+
+    int stepX = x0 < x1 ? 1 : -1;
+
+    int stepY = y0 < y1 ? 1 : -1;
+
+    int error = dx + dy;
+
+
+    while (true) {
+
+        setPixel(x0, y0, color);
+
+        if (x0 == x1 && y0 == y1) break;
+
+
+        int error2 = 2 * error;
+
+        if (error2 >= dy) {
+
+            error += dy;
+
+            x0 += stepX;
+
+        }
+
+        if (error2 <= dx) {
+
+            error += dx;
+
+            y0 += stepY;
+
+        }
+
+    }
+
+}
+
+
+// midpoint circle, either just the outline or filled in with lines across
+
+static void drawCircle(int centerX, int centerY, int radius, unsigned int color, bool filled) {
+
+    int x = radius;
+
+    int y = 0;
+
+    int error = 1 - radius;
+
+
+    while (x >= y) {
+
+        if (filled) {
+
+            drawLine(centerX - x, centerY + y, centerX + x, centerY + y, color);
+
+            drawLine(centerX - x, centerY - y, centerX + x, centerY - y, color);
+
+            drawLine(centerX - y, centerY + x, centerX + y, centerY + x, color);
+
+            drawLine(centerX - y, centerY - x, centerX + y, centerY - x, color);
+
+        } else {
+
+            setPixel(centerX + x, centerY + y, color);
+
+            setPixel(centerX - x, centerY + y, color);
+
+            setPixel(centerX + x, centerY - y, color);
+
+            setPixel(centerX - x, centerY - y, color);
+
+            setPixel(centerX + y, centerY + x, color);
+
+            setPixel(centerX - y, centerY + x, color);
+
+            setPixel(centerX + y, centerY - x, color);
+
+            setPixel(centerX - y, centerY - x, color);
+
+        }
+
+
+        y++;
+
+        if (error < 0) {
+
+            error += 2 * y + 1;
+
+        } else {
+
+            x--;
+
+            error += 2 * (y - x) + 1;
+
+        }
+
+    }
+
+}
+
+
+// 5x7 font for ' ' to '~', a column per byte with the top row in the low bit (the bottom bit is for descenders)
+
+const unsigned char FONT[95][5] = {
+
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14},
+
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, {0x36, 0x49, 0x56, 0x20, 0x50}, {0x00, 0x08, 0x07, 0x03, 0x00},
+
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x2A, 0x1C, 0x7F, 0x1C, 0x2A}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+
+    {0x00, 0x80, 0x70, 0x30, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x00, 0x60, 0x60, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},
+
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, {0x72, 0x49, 0x49, 0x49, 0x46}, {0x21, 0x41, 0x49, 0x4D, 0x33},
+
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x31}, {0x41, 0x21, 0x11, 0x09, 0x07},
+
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x46, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x00, 0x14, 0x00, 0x00}, {0x00, 0x40, 0x34, 0x00, 0x00},
+
+    {0x00, 0x08, 0x14, 0x22, 0x41}, {0x14, 0x14, 0x14, 0x14, 0x14}, {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x59, 0x09, 0x06},
+
+    {0x3E, 0x41, 0x5D, 0x59, 0x4E}, {0x7C, 0x12, 0x11, 0x12, 0x7C}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+
+    {0x7F, 0x41, 0x41, 0x41, 0x3E}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01}, {0x3E, 0x41, 0x41, 0x51, 0x73},
+
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41},
+
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x1C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x26, 0x49, 0x49, 0x49, 0x32},
+
+    {0x03, 0x01, 0x7F, 0x01, 0x03}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F},
+
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x59, 0x49, 0x4D, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x41},
+
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x41, 0x7F}, {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},
+
+    {0x00, 0x03, 0x07, 0x08, 0x00}, {0x20, 0x54, 0x54, 0x78, 0x40}, {0x7F, 0x28, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x28},
+
+    {0x38, 0x44, 0x44, 0x28, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18}, {0x00, 0x08, 0x7E, 0x09, 0x02}, {0x18, 0xA4, 0xA4, 0x9C, 0x78},
+
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x40, 0x3D, 0x00}, {0x7F, 0x10, 0x28, 0x44, 0x00},
+
+    {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x78, 0x04, 0x78}, {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38},
+
+    {0xFC, 0x18, 0x24, 0x24, 0x18}, {0x18, 0x24, 0x24, 0x18, 0xFC}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x24},
+
+    {0x04, 0x04, 0x3F, 0x44, 0x24}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C},
+
+    {0x44, 0x28, 0x10, 0x28, 0x44}, {0x4C, 0x90, 0x90, 0x90, 0x7C}, {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00},
+
+    {0x00, 0x00, 0x77, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00}, {0x02, 0x01, 0x02, 0x04, 0x02}
+
+};
+
+
+// writes text with its top left corner at (x, y), each character on its own background cell like the Proteus does.
+
+// the font is drawn twice the size to about fill the cell
+
+static void drawText(const char text[], int x, int y, unsigned int color, unsigned int background) {
+
+    for (int i = 0; text[i] != '\0'; i++, x += CHAR_WIDTH) {
+
+        fillRectangle(x, y, CHAR_WIDTH, CHAR_HEIGHT, background);
+
+
+        char c = text[i] >= ' ' && text[i] <= '~' ? text[i] : '?';
+
+        const unsigned char* glyph = FONT[c - ' '];
+
+        for (int col = 0; col < 5; col++) {
+
+            for (int row = 0; row < 8; row++) {
+
+                if (glyph[col] >> row & 1) fillRectangle(x + 1 + 2 * col, y + 2 * row, 2, 2, color);
+
+            }
+
+        }
+
+    }
+
+}
+
+
+/*
+
+*   the LCD
+
+*/
+
+
+FEHLCD::FEHLCD() : fontColor(WHITE), backgroundColor(BLACK), cursorX(0), cursorY(0) {}
+
+
+void FEHLCD::Clear() {
+
+    Clear(backgroundColor);
+
+}
+
+
+void FEHLCD::Clear(unsigned int color) {
+
+    CallTimer timer(CALL_CLEAR);
+
+    fillRectangle(0, 0, HEADLESS_WIDTH, HEADLESS_HEIGHT, color);
+
+    cursorX = 0;
+
+    cursorY = 0;
+
+}
+
+
+void FEHLCD::SetFontColor(unsigned int color) {
+
+    CallTimer timer(CALL_SET_FONT_COLOR);
+
+    fontColor = color;
+
+}
+
+
+void FEHLCD::SetBackgroundColor(unsigned int color) {
+
+    CallTimer timer(CALL_SET_BACKGROUND_COLOR);
+
+    backgroundColor = color;
+
+}
+
+
+void FEHLCD::DrawPixel(int x, int y) {
+
+    CallTimer timer(CALL_DRAW_PIXEL);
+
+    setPixel(x, y, fontColor);
+
+}
+
+
+void FEHLCD::DrawHorizontalLine(int y, int x1, int x2) {
+
+    CallTimer timer(CALL_DRAW_HORIZONTAL_LINE);
+
+    if (x1 > x2) std::swap(x1, x2);
+
+    fillRectangle(x1, y, x2 - x1 + 1, 1, fontColor);
+
+}
+
+
+void FEHLCD::DrawVerticalLine(int x, int y1, int y2) {
+
+    CallTimer timer(CALL_DRAW_VERTICAL_LINE);
+
+    if (y1 > y2) std::swap(y1, y2);
+
+    fillRectangle(x, y1, 1, y2 - y1 + 1, fontColor);
+
+}
+
+
+void FEHLCD::DrawLine(int x1, int y1, int x2, int y2) {
+
+    CallTimer timer(CALL_DRAW_LINE);
+
+    drawLine(x1, y1, x2, y2, fontColor);
+
+}
+
+
+void FEHLCD::DrawRectangle(int x, int y, int width, int height) {
+
+    CallTimer timer(CALL_DRAW_RECTANGLE);
+
+    fillRectangle(x, y, width, 1, fontColor);
+
+    fillRectangle(x, y + height - 1, width, 1, fontColor);
+
+    fillRectangle(x, y, 1, height, fontColor);
+
+    fillRectangle(x + width - 1, y, 1, height, fontColor);
+
+}
+
+
+void FEHLCD::FillRectangle(int x, int y, int width, int height) {
+
+    CallTimer timer(CALL_FILL_RECTANGLE);
+
+    fillRectangle(x, y, width, height, fontColor);
+
+}
+
+
+void FEHLCD::DrawCircle(int x, int y, int radius) {
+
+    CallTimer timer(CALL_DRAW_CIRCLE);
+
+    drawCircle(x, y, radius, fontColor, false);
+
+}
+
+
+void FEHLCD::FillCircle(int x, int y, int radius) {
+
+    CallTimer timer(CALL_FILL_CIRCLE);
+
+    drawCircle(x, y, radius, fontColor, true);
+
+}
+
+
+// Write carries on from where the last one stopped, WriteLine goes to the next line afterwards
+
+void FEHLCD::Write(const char text[]) {
+
+    CallTimer timer(CALL_WRITE);
+
+    drawText(text, cursorX, cursorY, fontColor, backgroundColor);
+
+    cursorX += strlen(text) * CHAR_WIDTH;
+
+}
+
+
+void FEHLCD::Write(int value) {
+
+    char text[16];
+
+    snprintf(text, sizeof(text), "%d", value);
+
+    Write(text);
+
+}
+
+
+void FEHLCD::Write(float value) {
+
+    Write((double)value);
+
+}
+
+
+void FEHLCD::Write(double value) {
+
+    char text[32];
+
+    snprintf(text, sizeof(text), "%.3f", value);
+
+    Write(text);
+
+}
+
+
+void FEHLCD::WriteLine(const char text[]) {
+
+    Write(text);
+
+    cursorX = 0;
+
+    cursorY += CHAR_HEIGHT;
+
+}
+
+
+void FEHLCD::WriteLine(int value) {
+
+    Write(value);
+
+    cursorX = 0;
+
+    cursorY += CHAR_HEIGHT;
+
+}
+
+
+void FEHLCD::WriteLine(float value) {
+
+    WriteLine((double)value);
+
+}
+
+
+void FEHLCD::WriteLine(double value) {
+
+    Write(value);
+
+    cursorX = 0;
+
+    cursorY += CHAR_HEIGHT;
+
+}
+
+
+void FEHLCD::WriteAt(const char text[], int x, int y) {
+
+    CallTimer timer(CALL_WRITE_AT);
+
+    drawText(text, x, y, fontColor, backgroundColor);
+
+}
+
+
+void FEHLCD::WriteAt(int value, int x, int y) {
+
+    char text[16];
+
+    snprintf(text, sizeof(text), "%d", value);
+
+    WriteAt(text, x, y);
+
+}
+
+
+void FEHLCD::WriteAt(float value, int x, int y) {
+
+    WriteAt((double)value, x, y);
+
+}
+
+
+void FEHLCD::WriteAt(double value, int x, int y) {
+
+    char text[32];
+
+    snprintf(text, sizeof(text), "%.3f", value);
+
+    WriteAt(text, x, y);
+
+}
+
+
+// not timed, the time would be the script's (dumps and expects happen in here)
+
+bool FEHLCD::Touch(float* x, float* y) {
+
+    callStats[CALL_TOUCH].count++;
+
+    if (!realClock) clockTime += clockStep;
+
+    return nextTouch(*x, *y);
+
+}
+
+
+void FEHLCD::Update() {
+
+    CallTimer timer(CALL_UPDATE);
+
+}
+
+
+/*
+
+*   icons
+
+*/
+
+
+namespace FEHIcon {
+
+
+Icon::Icon() : x(0), y(0), width(0), height(0), color(WHITE), textColor(WHITE), selected(false) {
+
+    label[0] = '\0';
+
+}
+
+
+void Icon::SetProperties(const char name[20], int x, int y, int width, int height, unsigned int color, unsigned int textColor) {
+
+    snprintf(label, sizeof(label), "%s", name);
+
+    this->x = x;
+
+    this->y = y;
+
+    this->width = width;
+
+    this->height = height;
+
+    this->color = color;
+
+    this->textColor = textColor;
+
+    selected = false;
+
+}
+
+
+// the border, then the label in the middle
+
+void Icon::Draw() {
+
+    CallTimer timer(CALL_ICON_DRAW);
+
+    LCD.SetFontColor(color);
+
+    LCD.DrawRectangle(x, y, width, height);
+
+    LCD.SetFontColor(textColor);
+
+    LCD.WriteAt(label, x + (width - (int)strlen(label) * CHAR_WIDTH) / 2, y + (height - CHAR_HEIGHT) / 2);
+
+}
+
+
+// a selected icon has a second border just inside the first
+
+void Icon::Select() {
+
+    LCD.SetFontColor(color);
+
+    LCD.DrawRectangle(x + 1, y + 1, width - 2, height - 2);
+
+    selected = true;
+
+}
+
+
+void Icon::Deselect() {
+
+    LCD.SetFontColor(BLACK);
+
+    LCD.DrawRectangle(x + 1, y + 1, width - 2, height - 2);
+
+    selected = false;
+
+}
+
+
+int Icon::Pressed(float x, float y, int persist) {
+
+    CallTimer timer(CALL_ICON_PRESSED);
+
+    if (!WhilePressed(x, y)) return 0;
+
+    if (persist && !selected) Select();
+
+    return 1;
+
+}
+
+
+int Icon::WhilePressed(float x, float y) {
+
+    return x >= this->x && x <= this->x + width && y >= this->y && y <= this->y + height;
+
+}
+
+
+void Icon::ChangeLabelString(const char label[20]) {
+
+    snprintf(this->label, sizeof(this->label), "%s", label);
+
+    Draw();
+
+}
+
+
+void Icon::ChangeLabelInt(int value) {
+
+    snprintf(label, sizeof(label), "%d", value);
+
+    Draw();
+
+}
+
+
+void Icon::ChangeLabelFloat(float value) {
+
+    snprintf(label, sizeof(label), "%.3f", value);
+
+    Draw();
+
+}
+
+
+void DrawIconArray(Icon icons[], int rows, int cols, int top, int bottom, int left, int right, char labels[][20], unsigned int color, unsigned int textColor) {
+
+    CallTimer timer(CALL_DRAW_ICON_ARRAY);
+
+    int width = (HEADLESS_WIDTH - left - right) / cols;
+
+    int height = (HEADLESS_HEIGHT - top - bottom) / rows;
+
+
+    for (int row = 0; row < rows; row++) {
+
+        for (int col = 0; col < cols; col++) {
+
+            Icon& icon = icons[row * cols + col];
+
+            icon.SetProperties(labels[row * cols + col], left + col * width, top + row * height, width, height, color, textColor);
+
+            icon.Draw();
+
+        }
+
+    }
+
+}
+
+
+}
+
+
+/*
+
+*   images
+
+*/
+
+
+FEHImage::FEHImage() : width(0), height(0), pixels(NULL) {}
+
+
+FEHImage::~FEHImage() {
+
+    Close();
+
+}
+
+
+void FEHImage::Open(const char fileName[]) {
+
+    CallTimer timer(CALL_IMAGE_OPEN);
+
+    Close();
+
+
+    FILE* file = fopen(fileName, "r");
+
+    if (file == NULL) return;
+
+
+    if (fscanf(file, "%d %d", &height, &width) != 2 || width <= 0 || height <= 0) {
+
+        width = height = 0;
+
+        fclose(file);
+
+        return;
+
+    }
+
+
+    pixels = new int[width * height];
+
+    for (int i = 0; i < width * height; i++) {
+
+        pixels[i] = -1;
+
+        fscanf(file, "%d", &pixels[i]);
+
+    }
+
+    fclose(file);
+
+}
+
+
+void FEHImage::Draw(int x, int y) {
+
+    CallTimer timer(CALL_IMAGE_DRAW);
+
+    for (int row = 0; row < height; row++) {
+
+        for (int col = 0; col < width; col++) {
+
+            int color = pixels[row * width + col];
+
+            if (color != -1) setPixel(x + col, y + row, color);
+
+        }
+
+    }
+
+}
+
+
+void FEHImage::Close() {
+
+    delete[] pixels;
+
+    pixels = NULL;
+
+    width = height = 0;
+
+}
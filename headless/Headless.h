@@ -0,0 +1,57 @@
+// what the headless FEH libraries have on top of the Proteus ones, for tools that link against them
+
+
+#ifndef HEADLESS_H
+
+#define HEADLESS_H
+
+
+const int HEADLESS_WIDTH = 320;
+
+const int HEADLESS_HEIGHT = 240;
+
+
+// what the LCD is showing, 0xRRGGBB
+
+extern unsigned int headlessScreen[HEADLESS_HEIGHT][HEADLESS_WIDTH];
+
+
+// every library call that gets counted and timed
+
+enum HeadlessCall {
+
+    CALL_CLEAR, CALL_SET_FONT_COLOR, CALL_SET_BACKGROUND_COLOR,
+
+    CALL_DRAW_PIXEL, CALL_DRAW_HORIZONTAL_LINE, CALL_DRAW_VERTICAL_LINE, CALL_DRAW_LINE,
+
+    CALL_DRAW_RECTANGLE, CALL_FILL_RECTANGLE, CALL_DRAW_CIRCLE, CALL_FILL_CIRCLE,
+
+    CALL_WRITE, CALL_WRITE_AT, CALL_TOUCH, CALL_UPDATE,
+
+    CALL_ICON_DRAW, CALL_ICON_PRESSED, CALL_DRAW_ICON_ARRAY,
+
+    CALL_IMAGE_OPEN, CALL_IMAGE_DRAW,
+
+    HEADLESS_CALL_COUNT
+
+};
+
+
+// writes the screen as a binary PPM, false if the file can't be written
+
+bool writeScreenPPM(const char fileName[]);
+
+
+// how many pixels of the screen differ from the PPM in the file, -1 if it can't be read or is a different size
+
+int compareScreenPPM(const char fileName[]);
+
+
+// prints the count and time of each call made since the last time, under label, then starts counting again.
+
+// icon and image calls also count the LCD calls they make
+
+void printCallStats(const char label[]);
+
+
+#endif